@@ -0,0 +1,205 @@
+#include "bench.h"
+
+#define SM_IMPLEMENTATION
+#include "sm.h"
+
+// microbenchmarks of the core stepping functions, each machine is built from plain structs
+// so the same code can be measured for different amounts of transitions and contexts
+
+#define BENCH_MAX_DEGREE 256
+#define BENCH_MAX_CONTEXTS 262144
+
+typedef struct{
+  SM sm;
+  SM_State states[2];
+  SM_Transition initial;
+  SM_Transition transitions[BENCH_MAX_DEGREE];
+  SM_CompileMemory memory[4096];
+} BenchMachine;
+
+typedef struct{
+  BenchMachine* machine;
+  SM_Context* contexts;
+  size_t count;
+  int event_id;
+} BenchArg;
+
+static BenchMachine machine;
+static SM_Context contexts[BENCH_MAX_CONTEXTS];
+static uint16_t pool_states[BENCH_MAX_CONTEXTS];
+static uint64_t pool_halted[SM_CONTEXT_POOL_WORDS(BENCH_MAX_CONTEXTS)];
+static uint64_t pool_active[SM_CONTEXT_POOL_WORDS(BENCH_MAX_CONTEXTS)];
+static void* pool_user_contexts[BENCH_MAX_CONTEXTS];
+static uint64_t pool_file[(sizeof(SM_PoolFileHeader) + BENCH_MAX_CONTEXTS * 2 + BENCH_MAX_CONTEXTS / 8) / 8 + 1];
+
+bool bench_false_guard(void* user_context){
+  (void)(user_context);
+  return false;
+}
+
+bool bench_true_guard(void* user_context){
+  (void)(user_context);
+  return true;
+}
+
+bool bench_false_trigger(void* user_context, void* event){
+  (void)(user_context);
+  (void)(event);
+  return false;
+}
+
+bool bench_true_trigger(void* user_context, void* event){
+  (void)(user_context);
+  (void)(event);
+  return true;
+}
+
+typedef enum{
+  BenchKind_GUARD,
+  BenchKind_TRIGGER,
+  BenchKind_EVENT,
+  BenchKind_TOGGLE,
+} BenchKind;
+
+// a single state looping back to itself through degree transitions of which only the last one fires,
+// or for BenchKind_TOGGLE two states with an unconditional transition to each other
+void bench_machine_init(BenchMachine* self, BenchKind kind, size_t degree, bool compile){
+  *self = (BenchMachine){0};
+  SM_State_init(&self->states[0]);
+  SM_State_init(&self->states[1]);
+  SM_Transition_init(&self->initial, SM_INITIAL_STATE, &self->states[0]);
+  SM_add_transition(&self->sm, &self->initial);
+
+  for(size_t i = 0; i < degree; ++i){
+    SM_Transition* transition = &self->transitions[i];
+    bool last = i == degree - 1;
+    if(kind == BenchKind_TOGGLE){
+      SM_Transition_init(transition, &self->states[i % 2], &self->states[(i + 1) % 2]);
+    }else{
+      SM_Transition_init(transition, &self->states[0], &self->states[0]);
+    }
+    switch(kind){
+      case BenchKind_GUARD:
+        SM_Transition_set_guard(transition, last ? bench_true_guard : bench_false_guard);
+        break;
+      case BenchKind_TRIGGER:
+        SM_Transition_set_trigger(transition, last ? bench_true_trigger : bench_false_trigger);
+        break;
+      case BenchKind_EVENT:
+        SM_Transition_set_event(transition, (int)i);
+        break;
+      case BenchKind_TOGGLE:
+        break;
+    }
+    SM_add_transition(&self->sm, transition);
+  }
+  if(compile) SM_compile_into(&self->sm, self->memory, sizeof(self->memory));
+}
+
+// leaves the contexts in the first state of the machine
+void bench_contexts_init(BenchArg* arg){
+  for(size_t i = 0; i < arg->count; ++i){
+    SM_Context_init(&arg->contexts[i], NULL);
+    SM_step(&arg->machine->sm, &arg->contexts[i]);
+  }
+}
+
+void bench_step(void* arg, size_t iterations){
+  BenchArg* self = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_step(&self->machine->sm, self->contexts);
+}
+
+void bench_notify(void* arg, size_t iterations){
+  BenchArg* self = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_notify(&self->machine->sm, self->contexts, self);
+}
+
+void bench_notify_id(void* arg, size_t iterations){
+  BenchArg* self = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_notify_id(&self->machine->sm, self->contexts, self->event_id, NULL);
+}
+
+void bench_step_batch(void* arg, size_t iterations){
+  BenchArg* self = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_step_batch(&self->machine->sm, self->contexts, self->count, sizeof(SM_Context));
+}
+
+void bench_pool_step_all(void* arg, size_t iterations){
+  SM_ContextPool* pool = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_ContextPool_step_all(pool);
+}
+
+// wakes every 20th context before each step, so 5% of the pool is runnable
+void bench_pool_step_active(void* arg, size_t iterations){
+  SM_ContextPool* pool = arg;
+  for(size_t i = 0; i < iterations; ++i){
+    for(size_t index = 0; index < pool->count; index += 20) SM_ContextPool_wake(pool, index);
+    SM_ContextPool_step_active(pool);
+  }
+}
+
+void bench_pool_load_file(void* arg, size_t iterations){
+  SM_ContextPool* pool = arg;
+  for(size_t i = 0; i < iterations; ++i) SM_ContextPool_load_file(pool, pool_file, sizeof(pool_file));
+}
+
+void bench_transitions(BenchKind kind, const char* benchmark, BenchFunction function, bool compile, const char* unit){
+  static const size_t degrees[] = { 1, 4, 16, 64, 256 };
+  for(size_t d = 0; d < sizeof(degrees) / sizeof(degrees[0]); ++d){
+    bench_machine_init(&machine, kind, degrees[d], compile);
+    BenchArg arg = { .machine = &machine, .contexts = contexts, .count = 1, .event_id = (int)degrees[d] - 1 };
+    bench_contexts_init(&arg);
+    char parameter[32];
+    snprintf(parameter, sizeof(parameter), "transitions=%zu", degrees[d]);
+    bench_report(benchmark, parameter, bench_measure(function, &arg), unit);
+  }
+}
+
+void bench_contexts(void){
+  static const size_t counts[] = { 1024, 65536, BENCH_MAX_CONTEXTS };
+  bench_machine_init(&machine, BenchKind_TOGGLE, 2, true);
+  for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c){
+    char parameter[32];
+    snprintf(parameter, sizeof(parameter), "contexts=%zu", counts[c]);
+
+    BenchArg arg = { .machine = &machine, .contexts = contexts, .count = counts[c] };
+    bench_contexts_init(&arg);
+    bench_report("step_batch", parameter, bench_measure(bench_step_batch, &arg) / (double)counts[c], "ns/step");
+
+    SM_ContextPool pool;
+    SM_ContextPool_init(&pool, &machine.sm, pool_states, pool_halted, pool_user_contexts, counts[c]);
+    bench_report("pool_step_all", parameter, bench_measure(bench_pool_step_all, &pool) / (double)counts[c], "ns/step");
+
+    SM_ContextPool_save_file(&pool, pool_file, sizeof(pool_file));
+    bench_report("pool_load_file", parameter, bench_measure(bench_pool_load_file, &pool) / (double)counts[c], "ns/context");
+  }
+}
+
+// contexts waiting for an event, only a few of which are woken each tick
+void bench_idle_contexts(void){
+  static const size_t counts[] = { 65536, BENCH_MAX_CONTEXTS };
+  bench_machine_init(&machine, BenchKind_TRIGGER, 1, true);
+  for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c){
+    char parameter[48];
+    snprintf(parameter, sizeof(parameter), "contexts=%zu,runnable=5%%", counts[c]);
+
+    SM_ContextPool pool;
+    SM_ContextPool_init(&pool, &machine.sm, pool_states, pool_halted, pool_user_contexts, counts[c]);
+    SM_ContextPool_step_all(&pool); // initial transitions
+    bench_report("pool_step_all", parameter, bench_measure(bench_pool_step_all, &pool), "ns/tick");
+
+    SM_ContextPool_set_active(&pool, pool_active);
+    bench_report("pool_step_active", parameter, bench_measure(bench_pool_step_active, &pool), "ns/tick");
+  }
+}
+
+int main(void){
+  bench_transitions(BenchKind_GUARD, "step", bench_step, true, "ns/step");
+  bench_transitions(BenchKind_GUARD, "step_chain", bench_step, false, "ns/step");
+  bench_transitions(BenchKind_TRIGGER, "notify", bench_notify, true, "ns/notify");
+  bench_transitions(BenchKind_TRIGGER, "notify_chain", bench_notify, false, "ns/notify");
+  bench_transitions(BenchKind_EVENT, "notify_id", bench_notify_id, true, "ns/notify");
+  bench_contexts();
+  bench_idle_contexts();
+  return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// shared harness of the benchmarks, every result is printed as one tab separated line:
+// benchmark, parameter, value and unit
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// BENCH_MIN_TIME_NS can be defined by the user, minimum duration of a single measurement
+#ifndef BENCH_MIN_TIME_NS
+#define BENCH_MIN_TIME_NS 200000000ull
+#endif
+
+typedef void (*BenchFunction)(void* arg, size_t iterations);
+
+static uint64_t bench_now_ns(void){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// doubles the amount of iterations until a run takes atleast BENCH_MIN_TIME_NS, returns ns per iteration of that run
+static double bench_measure(BenchFunction function, void* arg){
+  function(arg, 1); // warm up
+  for(size_t iterations = 1;; iterations *= 2){
+    uint64_t start = bench_now_ns();
+    function(arg, iterations);
+    uint64_t elapsed = bench_now_ns() - start;
+    if(elapsed >= BENCH_MIN_TIME_NS) return (double)elapsed / (double)iterations;
+  }
+}
+
+static void bench_report(const char* benchmark, const char* parameter, double value, const char* unit){
+  printf("%s\t%s\t%.3f\t%s\n", benchmark, parameter, value, unit);
+  fflush(stdout);
+}
+
+#endif // BENCH_H_
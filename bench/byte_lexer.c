@@ -0,0 +1,54 @@
+#include "bench.h"
+
+// end to end throughput of examples/byte_lexer.c
+#define main byte_lexer_example_main
+#include "../examples/byte_lexer.c"
+#undef main
+
+#define BENCH_INPUT_SIZE (8u << 20)
+
+static char input[BENCH_INPUT_SIZE];
+static size_t input_length;
+
+typedef struct{
+  Lexer lexer;
+  size_t tokens;
+} BenchLexer;
+
+void bench_count_token(void* ctx, Token* token){
+  (void)(token);
+  BenchLexer* self = ctx;
+  self->tokens++;
+}
+
+void bench_lex(void* arg, size_t iterations){
+  BenchLexer* self = arg;
+  for(size_t i = 0; i < iterations; ++i){
+    Lexer_init(&self->lexer, bench_count_token, self);
+    Lexer_lex(&self->lexer, input, input_length);
+  }
+}
+
+// same csv rows as bench/lexer.c
+void bench_input_init(void){
+  static const char* rows[] = {
+    "alpha, 12345, some longer text field, 42\n",
+    "beta, 7, short, 1234567890\n",
+    "gamma delta, 31415926, another text field with more words, 0\n",
+  };
+  for(size_t row = 0;; ++row){
+    const char* text = rows[row % 3];
+    size_t row_length = strlen(text);
+    if(input_length + row_length > BENCH_INPUT_SIZE) break;
+    memcpy(&input[input_length], text, row_length);
+    input_length += row_length;
+  }
+}
+
+int main(void){
+  bench_input_init();
+  static BenchLexer bench = {0};
+  double ns = bench_measure(bench_lex, &bench);
+  bench_report("byte_lexer", "input=8MiB", (double)input_length / ns * 1e9 / (1 << 20), "MiB/s");
+  return bench.tokens > 0 ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#include "bench.h"
+
+// end to end throughput of examples/game_of_life.c on a larger grid
+#define SIZE 256
+#define main game_of_life_example_main
+#include "../examples/game_of_life.c"
+#undef main
+
+void bench_update(void* arg, size_t iterations){
+  for(size_t i = 0; i < iterations; ++i) Grid_update(arg);
+}
+
+int main(void){
+  Cell_init_state_machine();
+  static Grid grid;
+  Grid_init(&grid);
+
+  // deterministic pseudo random start, roughly a third of the cells alive
+  uint32_t seed = 12345;
+  for(int y = 0; y < SIZE; ++y){
+    for(int x = 0; x < SIZE; ++x){
+      seed = seed * 1664525u + 1013904223u;
+      grid.cells[y][x].alive = (seed >> 24) % 3 == 0;
+    }
+  }
+  Grid_update(&grid);
+
+  double ns = bench_measure(bench_update, &grid);
+#ifdef SM_DIRTY
+  bench_report("game_of_life", "cells=65536,dirty", (double)(SIZE * SIZE) / ns * 1e9, "cells/s");
+#else
+  bench_report("game_of_life", "cells=65536", (double)(SIZE * SIZE) / ns * 1e9, "cells/s");
+#endif
+  return 0;
+}
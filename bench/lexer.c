@@ -0,0 +1,62 @@
+#include "bench.h"
+
+// end to end throughput of examples/lexer.c, built with LEXER_GENERATED for the generated state machine
+#define main lexer_example_main
+#include "../examples/lexer.c"
+#undef main
+
+#include <string.h>
+
+#define BENCH_INPUT_SIZE (8u << 20)
+
+static char input[BENCH_INPUT_SIZE + 1];
+
+typedef struct{
+  Lexer lexer;
+  size_t tokens;
+} BenchLexer;
+
+void bench_count_token(void* ctx, Token* token){
+  (void)(token);
+  BenchLexer* self = ctx;
+  self->tokens++;
+}
+
+void bench_lex(void* arg, size_t iterations){
+  BenchLexer* self = arg;
+  for(size_t i = 0; i < iterations; ++i){
+    Lexer_init(&self->lexer, bench_count_token, self);
+    Lexer_lex(&self->lexer, input);
+  }
+}
+
+// fills the input with csv rows, lexer.c stops at the terminating '\0'
+void bench_input_init(void){
+  static const char* rows[] = {
+    "alpha, 12345, some longer text field, 42\n",
+    "beta, 7, short, 1234567890\n",
+    "gamma delta, 31415926, another text field with more words, 0\n",
+  };
+  size_t length = 0;
+  for(size_t row = 0;; ++row){
+    const char* text = rows[row % 3];
+    size_t row_length = strlen(text);
+    if(length + row_length > BENCH_INPUT_SIZE) break;
+    memcpy(&input[length], text, row_length);
+    length += row_length;
+  }
+  input[length] = '\0';
+}
+
+int main(void){
+  bench_input_init();
+  static BenchLexer bench = {0};
+  double ns = bench_measure(bench_lex, &bench);
+#ifdef LEXER_GENERATED
+  const char* benchmark = "lexer_generated";
+#else
+  const char* benchmark = "lexer";
+#endif
+  bench_report(benchmark, "input=8MiB", (double)strlen(input) / ns * 1e9 / (1 << 20), "MiB/s");
+  return bench.tokens > 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include "bench.h"
+
+#include <stdlib.h>
+
+#define SM_IMPLEMENTATION
+#define SM_RECORD
+#include "sm.h"
+
+// replays a recorded log of calls spread over many contexts, like traffic recorded in production
+
+#define BENCH_CONTEXTS 1024
+#define BENCH_CALLS 1000000
+
+typedef struct{
+  uint32_t value;
+} BenchEvent;
+
+bool bench_even_trigger(void* user_context, void* event){
+  (void)(user_context);
+  return ((BenchEvent*)event)->value % 2 == 0;
+}
+
+SM_def(sm);
+
+static SM_Context contexts[BENCH_CONTEXTS];
+
+typedef struct{
+  const void* log;
+  size_t size;
+} BenchLog;
+
+void bench_replay(void* arg, size_t iterations){
+  BenchLog* self = arg;
+  for(size_t i = 0; i < iterations; ++i){
+    for(uint32_t c = 0; c < BENCH_CONTEXTS; ++c) SM_Context_init(&contexts[c], NULL);
+    SM_replay(sm, contexts, BENCH_CONTEXTS, self->log, self->size);
+  }
+}
+
+int main(void){
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_set_trigger(B_to_A, bench_even_trigger);
+  SM_compile(sm, 1024);
+
+  FILE* file = tmpfile();
+  static char buffer[1 << 16];
+  SM_Recorder recorder;
+  SM_Recorder_init(&recorder, file, buffer, sizeof(buffer), sizeof(BenchEvent));
+  SM_Recorder_attach(&recorder);
+  for(uint32_t c = 0; c < BENCH_CONTEXTS; ++c){
+    SM_Context_init(&contexts[c], NULL);
+    SM_Context_set_id(&contexts[c], c);
+    SM_step(sm, &contexts[c]);
+  }
+  uint32_t seed = 12345;
+  for(size_t i = 0; i < BENCH_CALLS; ++i){
+    seed = seed * 1664525u + 1013904223u;
+    SM_Context* context = &contexts[(seed >> 8) % BENCH_CONTEXTS];
+    BenchEvent event = { .value = seed >> 24 };
+    if(seed & 1) SM_notify_id(sm, context, 1, &event);
+    else SM_notify(sm, context, &event);
+  }
+  SM_Recorder_attach(NULL);
+  SM_Recorder_flush(&recorder);
+
+  BenchLog log = { .size = (size_t)ftell(file) };
+  void* memory = malloc(log.size);
+  rewind(file);
+  if(memory == NULL || fread(memory, 1, log.size, file) != log.size) return 1;
+  fclose(file);
+  log.log = memory;
+
+  double ns = bench_measure(bench_replay, &log);
+  bench_report("replay", "calls=1000000", ns / (BENCH_CALLS + BENCH_CONTEXTS), "ns/call");
+  free(memory);
+  return 0;
+}
@@ -0,0 +1,172 @@
+// generated by SM_codegen() for state machine 'lexer', do not edit
+
+#include <stdbool.h>
+
+bool Lexer_unknown_to_newline_guard(void* user_context);
+void Lexer_unknown_to_newline_effect(void* user_context);
+bool Lexer_unknown_to_word_guard(void* user_context);
+void Lexer_unknown_to_word_effect(void* user_context);
+bool Lexer_unknown_to_number_guard(void* user_context);
+void Lexer_unknown_to_number_effect(void* user_context);
+bool Lexer_unknown_to_seperator_guard(void* user_context);
+void Lexer_unknown_to_seperator_effect(void* user_context);
+bool Lexer_unknown_to_eof_guard(void* user_context);
+void Lexer_unknown_to_eof_effect(void* user_context);
+void Lexer_unknown_to_unknown_effect(void* user_context);
+bool Lexer_newline_to_unknown_guard(void* user_context);
+void Lexer_newline_to_unknown_effect(void* user_context);
+bool Lexer_word_to_word_guard(void* user_context);
+void Lexer_word_to_word_effect(void* user_context);
+bool Lexer_word_to_unknown_guard(void* user_context);
+void Lexer_word_to_unknown_effect(void* user_context);
+bool Lexer_number_to_number_guard(void* user_context);
+void Lexer_number_to_number_effect(void* user_context);
+bool Lexer_number_to_unkown_guard(void* user_context);
+void Lexer_number_to_unkown_effect(void* user_context);
+void Lexer_seperator_to_unknown_effect(void* user_context);
+void Lexer_eof_to_final_effect(void* user_context);
+
+typedef enum{
+  lexer_STATE_INITIAL = 0,
+  lexer_STATE_unknown = 1,
+  lexer_STATE_newline = 2,
+  lexer_STATE_word = 3,
+  lexer_STATE_number = 4,
+  lexer_STATE_seperator = 5,
+  lexer_STATE_eof = 6,
+} lexer_State;
+
+typedef struct{
+  void* user_context;
+  lexer_State current_state;
+  bool halted;
+} lexer_Context;
+
+void lexer_Context_init(lexer_Context* self, void* user_context){
+  self->user_context = user_context;
+  self->current_state = lexer_STATE_INITIAL;
+  self->halted = false;
+}
+
+bool lexer_step(lexer_Context* self){
+  void* user_context = self->user_context;
+  (void)(user_context);
+  if(self->halted) return false;
+  switch(self->current_state){
+    case lexer_STATE_INITIAL:
+      // initial_to_unknown
+      self->current_state = lexer_STATE_unknown;
+      return true;
+    case lexer_STATE_unknown:
+      if(Lexer_unknown_to_newline_guard(user_context)){
+        // unknown_to_newline
+        Lexer_unknown_to_newline_effect(user_context);
+        self->current_state = lexer_STATE_newline;
+        return true;
+      }
+      if(Lexer_unknown_to_word_guard(user_context)){
+        // unknown_to_word
+        Lexer_unknown_to_word_effect(user_context);
+        self->current_state = lexer_STATE_word;
+        return true;
+      }
+      if(Lexer_unknown_to_number_guard(user_context)){
+        // unknown_to_number
+        Lexer_unknown_to_number_effect(user_context);
+        self->current_state = lexer_STATE_number;
+        return true;
+      }
+      if(Lexer_unknown_to_seperator_guard(user_context)){
+        // unknown_to_seperator
+        Lexer_unknown_to_seperator_effect(user_context);
+        self->current_state = lexer_STATE_seperator;
+        return true;
+      }
+      if(Lexer_unknown_to_eof_guard(user_context)){
+        // unknown_to_eof
+        Lexer_unknown_to_eof_effect(user_context);
+        self->current_state = lexer_STATE_eof;
+        return true;
+      }
+      // unknown_to_unknown
+      Lexer_unknown_to_unknown_effect(user_context);
+      self->current_state = lexer_STATE_unknown;
+      return true;
+    case lexer_STATE_newline:
+      if(Lexer_newline_to_unknown_guard(user_context)){
+        // newline_to_unknown
+        Lexer_newline_to_unknown_effect(user_context);
+        self->current_state = lexer_STATE_unknown;
+        return true;
+      }
+      return true;
+    case lexer_STATE_word:
+      if(Lexer_word_to_word_guard(user_context)){
+        // word_to_word
+        Lexer_word_to_word_effect(user_context);
+        self->current_state = lexer_STATE_word;
+        return true;
+      }
+      if(Lexer_word_to_unknown_guard(user_context)){
+        // word_to_unknown
+        Lexer_word_to_unknown_effect(user_context);
+        self->current_state = lexer_STATE_unknown;
+        return true;
+      }
+      return true;
+    case lexer_STATE_number:
+      if(Lexer_number_to_number_guard(user_context)){
+        // number_to_number
+        Lexer_number_to_number_effect(user_context);
+        self->current_state = lexer_STATE_number;
+        return true;
+      }
+      if(Lexer_number_to_unkown_guard(user_context)){
+        // number_to_unknown
+        Lexer_number_to_unkown_effect(user_context);
+        self->current_state = lexer_STATE_unknown;
+        return true;
+      }
+      return true;
+    case lexer_STATE_seperator:
+      // seperator_to_unknown
+      Lexer_seperator_to_unknown_effect(user_context);
+      self->current_state = lexer_STATE_unknown;
+      return true;
+    case lexer_STATE_eof:
+      // eof_to_final
+      Lexer_eof_to_final_effect(user_context);
+      self->current_state = lexer_STATE_INITIAL;
+      self->halted = true;
+      return true;
+    default:
+      return true;
+  }
+}
+
+bool lexer_notify(lexer_Context* self, void* event){
+  void* user_context = self->user_context;
+  (void)(user_context);
+  (void)(event);
+  if(self->halted) return false;
+  switch(self->current_state){
+    default:
+      return false;
+  }
+}
+
+bool lexer_notify_id(lexer_Context* self, int event_id, void* event){
+  void* user_context = self->user_context;
+  (void)(user_context);
+  (void)(event_id);
+  (void)(event);
+  if(self->halted) return false;
+  switch(self->current_state){
+    default:
+      return false;
+  }
+}
+
+void lexer_run(lexer_Context* self){
+  while(lexer_step(self));
+}
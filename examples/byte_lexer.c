@@ -0,0 +1,166 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SM_IMPLEMENTATION
+#include "sm.h"
+
+// same tokens as lexer.c but driven by byte transitions, each byte is looked up in a table of the current state
+// instead of checking the guards of every transition
+
+typedef enum{
+  TokenType_WORD,
+  TokenType_NUMBER,
+  TokenType_SEPERATOR,
+  TokenType_NEWLINE,
+  TokenType_EOF,
+} TokenType;
+
+const char* TokenType_to_str(TokenType type){
+  switch (type) {
+    case TokenType_WORD: return "WORD";
+    case TokenType_NUMBER: return "NUMBER";
+    case TokenType_SEPERATOR: return "SEPERATOR";
+    case TokenType_NEWLINE: return "NEWLINE";
+    case TokenType_EOF: return "EOF";
+  }
+  assert(false && "invalid TokenType");
+  return NULL;
+}
+
+typedef struct{
+  const char* str;
+  size_t len;
+  TokenType type;
+} Token;
+
+typedef struct{
+  Token current_token;
+  SM_Context sm_context;
+  void (*token_handler)(void* context, Token* token);
+  void* token_handler_context;
+} Lexer;
+
+void Lexer_emit(Lexer* self, const char* str, size_t len, TokenType type){
+  Token token = { .str = str, .len = len, .type = type };
+  if(self->token_handler)
+    self->token_handler(self->token_handler_context, &token);
+}
+
+// emits the word or number being lexed if there is one
+void Lexer_finish(void* context, const uint8_t* bytes, size_t length){
+  (void)(bytes);
+  (void)(length);
+  Lexer* self = context;
+  if(self->current_token.len > 0){
+    Lexer_emit(self, self->current_token.str, self->current_token.len, self->current_token.type);
+    self->current_token.len = 0;
+  }
+}
+
+void Lexer_begin_word(void* context, const uint8_t* bytes, size_t length){
+  Lexer* self = context;
+  self->current_token = (Token){ .str = (const char*)bytes, .len = length, .type = TokenType_WORD };
+}
+
+void Lexer_begin_number(void* context, const uint8_t* bytes, size_t length){
+  Lexer* self = context;
+  self->current_token = (Token){ .str = (const char*)bytes, .len = length, .type = TokenType_NUMBER };
+}
+
+void Lexer_extend(void* context, const uint8_t* bytes, size_t length){
+  (void)(bytes);
+  Lexer* self = context;
+  self->current_token.len += length;
+}
+
+void Lexer_punctuation(void* context, const uint8_t* bytes, size_t length){
+  Lexer_finish(context, bytes, length);
+  Lexer_emit(context, (const char*)bytes, 1, *bytes == '\n' ? TokenType_NEWLINE : TokenType_SEPERATOR);
+}
+
+SM_def(sm);
+
+void Lexer_init(Lexer* self, void(*token_handler)(void* context, Token* token), void* token_handler_context){
+  self->token_handler = token_handler;
+  self->token_handler_context = token_handler_context;
+
+  SM_Context_init(&self->sm_context, self);
+
+  if(!sm->init){
+    SM_State_create(unknown);
+    SM_State_create(word);
+    SM_State_create(number);
+
+    // initial transition
+    SM_Transition_create(sm, initial_to_unknown, SM_INITIAL_STATE, unknown);
+
+    // unknown transitions, any byte not listed stops the lexer
+    SM_Transition_create(sm, unknown_to_word, unknown, word);
+    SM_Transition_set_byte_class(unknown_to_word, "a-zA-Z");
+    SM_Transition_set_byte_effect(unknown_to_word, Lexer_begin_word);
+
+    SM_Transition_create(sm, unknown_to_number, unknown, number);
+    SM_Transition_set_byte_class(unknown_to_number, "0-9");
+    SM_Transition_set_byte_effect(unknown_to_number, Lexer_begin_number);
+
+    SM_Transition_create(sm, unknown_to_unknown, unknown, unknown);
+    SM_Transition_set_byte_class(unknown_to_unknown, ",\n");
+    SM_Transition_set_byte_effect(unknown_to_unknown, Lexer_punctuation);
+
+    SM_Transition_create(sm, unknown_skip, unknown, unknown);
+    SM_Transition_set_byte_class(unknown_skip, " \t\r");
+
+    // word transitions
+    SM_Transition_create(sm, word_to_word, word, word);
+    SM_Transition_set_byte_class(word_to_word, "a-zA-Z ");
+    SM_Transition_set_byte_effect(word_to_word, Lexer_extend);
+
+    SM_Transition_create(sm, word_to_unknown, word, unknown);
+    SM_Transition_set_byte_class(word_to_unknown, ",\n");
+    SM_Transition_set_byte_effect(word_to_unknown, Lexer_punctuation);
+
+    // number transitions
+    SM_Transition_create(sm, number_to_number, number, number);
+    SM_Transition_set_byte_class(number_to_number, "0-9");
+    SM_Transition_set_byte_effect(number_to_number, Lexer_extend);
+
+    SM_Transition_create(sm, number_to_unknown, number, unknown);
+    SM_Transition_set_byte_class(number_to_unknown, ",\n");
+    SM_Transition_set_byte_effect(number_to_unknown, Lexer_punctuation);
+
+    SM_Transition_create(sm, number_skip, number, unknown);
+    SM_Transition_set_byte_class(number_skip, " \t\r");
+    SM_Transition_set_byte_effect(number_skip, Lexer_finish);
+
+    // builds the byte lookup tables
+    SM_compile(sm, 2048);
+  }
+}
+
+// returns false if the string contains a byte that can't be lexed
+bool Lexer_lex(Lexer* self, const char* str, size_t len){
+  SM_step(sm, &self->sm_context); // initial transition
+  size_t consumed = SM_feed_bytes(sm, &self->sm_context, str, len);
+  Lexer_finish(self, NULL, 0);
+  if(consumed < len){
+    fprintf(stderr, "unexpected byte '%c' at offset %zu\n", str[consumed], consumed);
+    return false;
+  }
+  Lexer_emit(self, str + len, 0, TokenType_EOF);
+  return true;
+}
+
+void print_token(void* ctx, Token* token){
+  (void)(ctx);
+  printf("token: %s, '%.*s'\n", TokenType_to_str(token->type), (int)token->len, token->str);
+}
+
+int main(void){
+  const char* text = "test, 123, end\n";
+  printf("Lexing the following text: '%s'\n", text);
+  Lexer lexer = {0};
+  Lexer_init(&lexer, print_token, NULL);
+  return Lexer_lex(&lexer, text, strlen(text)) ? 0 : 1;
+}
@@ -4,7 +4,9 @@
 #define SM_IMPLEMENTATION
 #include "sm.h"
 
+#ifndef SIZE
 #define SIZE 5
+#endif
 
 typedef enum{
   Direction_NORTH = 0,
@@ -65,20 +67,19 @@ typedef struct{
   int x;
   int y;
   bool alive;
-  bool next_alive;
   void* grid;
   SM_Context sm_context;
 } Cell;
 
 typedef struct{
   Cell cells[SIZE][SIZE];
+  SM_Transition* next[SIZE * SIZE];
 } Grid;
 
 void Grid_init(Grid* self){
   for(int y = 0; y < SIZE; ++y){
     for(int x = 0; x < SIZE; ++x){
       self->cells[y][x] = (Cell){
-        .next_alive = false,
         .alive = false,
         .grid = self,
         .x = x,
@@ -110,20 +111,8 @@ Cell* Grid_get_cell(Grid* self, int x, int y){
 }
 
 void Grid_update(Grid* self){
-  // determine new states for cells
-  for(int y = 0; y < SIZE; ++y){
-    for(int x = 0; x < SIZE; ++x){
-      SM_step(sm, &Grid_get_cell(self, x, y)->sm_context);
-    }
-  }
-
-  // sync cell states to new state
-  for(int y = 0; y < SIZE; ++y){
-    for(int x = 0; x < SIZE; ++x){
-      Cell* cell = Grid_get_cell(self, x, y);
-      cell->alive = cell->next_alive;
-    }
-  }
+  // all guards see the previous generation before any cell changes state
+  SM_step_sync(sm, &self->cells[0][0].sm_context, SIZE * SIZE, sizeof(Cell), self->next);
 }
 
 Cell* Cell_get_neighbor(Cell* self, Direction direction){
@@ -133,14 +122,27 @@ Cell* Cell_get_neighbor(Cell* self, Direction direction){
   return neighbor;
 }
 
+// with SM_DIRTY only cells next to a changed cell check their guards
+void Cell_invalidate_neighbors(Cell* self){
+#ifdef SM_DIRTY
+  for(Direction direction = 0; direction < Direction_END; ++direction){
+    SM_Context_invalidate(&Cell_get_neighbor(self, direction)->sm_context);
+  }
+#else
+  (void)(self);
+#endif
+}
+
 void Cell_state_alive_enter(void* ctx){
   Cell* self = ctx;
-  self->next_alive = true;
+  self->alive = true;
+  Cell_invalidate_neighbors(self);
 }
 
 void Cell_state_dead_enter(void* ctx){
   Cell* self = ctx;
-  self->next_alive = false;
+  self->alive = false;
+  Cell_invalidate_neighbors(self);
 }
 
 int Cell_count_alive_neighors(Cell* self){
@@ -169,7 +171,8 @@ bool Cell_initial_to_alive_guard(void* ctx){
   return self->alive;
 }
 
-int main(void){
+void Cell_init_state_machine(void){
+  if(sm->init) return;
 
   // cell states 
   SM_State_create(alive);
@@ -194,6 +197,13 @@ int main(void){
   SM_Transition_create(sm, dead_to_alive, dead, alive);
   SM_Transition_set_guard(dead_to_alive, Cell_dead_to_alive_guard);
 
+  // pack transitions into contiguous arrays for faster lookups
+  SM_compile(sm, 1024);
+}
+
+int main(void){
+  Cell_init_state_machine();
+
   Grid grid = {0};
   Grid_init(&grid);
   
@@ -214,4 +224,5 @@ int main(void){
     Grid_update(&grid);
 
   }
+  return 0;
 }
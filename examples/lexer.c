@@ -6,6 +6,11 @@
 #define SM_IMPLEMENTATION
 #include "sm.h"
 
+// build/lexer_sm.c is generated by running this example with SM_CODEGEN defined, see the codegen make target
+#ifdef LEXER_GENERATED
+#include "lexer_sm.c"
+#endif
+
 typedef enum{
   TokenType_UNKNOWN,
   TokenType_WORD,
@@ -27,6 +32,7 @@ const char* TokenType_to_str(TokenType type){
     case TokenType_END: break;
   }
   assert(false && "invalid TokenType");
+  return NULL;
 }
 
 typedef struct{
@@ -247,12 +253,21 @@ void Lexer_init(Lexer* self, void(*token_handler)(void* context, Token* token),
     // final transition
     SM_Transition_create(sm, eof_to_final, eof, SM_FINAL_STATE);
     SM_Transition_set_effect(eof_to_final, Lexer_eof_to_final_effect);
+
+    // pack transitions into contiguous arrays for faster lookups
+    SM_compile(sm, 1024);
   }
 }
 
 void Lexer_lex(Lexer* self, const char* str){
   self->str = str;
+#ifdef LEXER_GENERATED
+  lexer_Context context;
+  lexer_Context_init(&context, self);
+  lexer_run(&context);
+#else
   SM_run(sm, &self->sm_context);
+#endif
 }
 
 void print_token(void* ctx, Token* token){
@@ -261,12 +276,17 @@ void print_token(void* ctx, Token* token){
 }
 
 int main(void){
+  Lexer lexer = {0};
+  Lexer_init(&lexer, print_token, NULL);
 
+#ifdef SM_CODEGEN
+  // write the state machine built by Lexer_init() as C source
+  return SM_codegen(sm, stdout, "lexer") ? 0 : 1;
+#else
   const char* text = "test, 123, end\n";
   printf("Lexing the following text: '%s'\n", text);
-  Lexer lexer = {0};
-  Lexer_init(&lexer, print_token, NULL);
   Lexer_lex(&lexer, text);
 
   return 0;
+#endif
 }
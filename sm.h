@@ -27,6 +27,8 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 // define for tracing transitions using SM_TRACE_LOG_FMT
 #ifdef SM_TRACE
@@ -49,14 +51,201 @@
 #define SM_ASSERT(statement) assert(statement)
 #endif
 
+// define for recording the names of callbacks so SM_codegen() can emit direct calls to them,
+// changes the layout of SM_State and SM_Transition so it must be defined consistently in every translation unit
+#ifdef SM_CODEGEN
+#include <stdio.h>
+#include <string.h>
+#endif
+
+// define for recording every call of SM_step(), SM_notify(), SM_notify_id() and SM_feed_bytes() made by a thread, see SM_Recorder_attach() and SM_replay()
+#ifdef SM_RECORD
+#include <stdio.h>
+
+// SM_RECORD_MAX_EVENT_SIZE can be defined by the user, maximum size in bytes of the recorded events
+#ifndef SM_RECORD_MAX_EVENT_SIZE
+#define SM_RECORD_MAX_EVENT_SIZE 256
+#endif
+#endif
+
+// define for SM_ContextPool_open(), which maps a pool file into memory using POSIX mmap()
+#ifdef SM_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// define for tracing transitions as fixed size binary records into a ring buffer of the stepping thread,
+// see SM_TraceRing_attach() and SM_trace_decode()
+#ifdef SM_TRACE_BINARY
+#include <stdio.h>
+#endif
+
+// SM_THREAD_LOCAL can be defined by the user
+#if (defined(SM_TRACE_BINARY) || defined(SM_RECORD)) && !defined(SM_THREAD_LOCAL)
+#if defined(__GNUC__) || defined(__clang__)
+#define SM_THREAD_LOCAL __thread
+#else
+#define SM_THREAD_LOCAL _Thread_local
+#endif
+#endif
+
+// SM_ATOMIC_* can be defined by the user, defaults to the GCC/Clang __atomic builtins
+#ifndef SM_ATOMIC_LOAD_ACQUIRE
+#define SM_ATOMIC_LOAD_RELAXED(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define SM_ATOMIC_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define SM_ATOMIC_STORE_RELEASE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define SM_ATOMIC_FETCH_ADD_RELAXED(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+#define SM_ATOMIC_CAS_RELAXED(ptr, expected, desired) \
+  __atomic_compare_exchange_n((ptr), (expected), (desired), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+// SM_PREFETCH can be defined by the user
+#ifndef SM_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define SM_PREFETCH(ptr) __builtin_prefetch((ptr))
+#else
+#define SM_PREFETCH(ptr) ((void)(ptr))
+#endif
+#endif
+
+// SM_PREFETCH_DISTANCE can be defined by the user, amount of contexts prefetched ahead by the batch functions
+#ifndef SM_PREFETCH_DISTANCE
+#define SM_PREFETCH_DISTANCE 8
+#endif
+
+// SM_CACHE_LINE_SIZE can be defined by the user
+#ifndef SM_CACHE_LINE_SIZE
+#define SM_CACHE_LINE_SIZE 64
+#endif
+
+// SM_BYTE_RUN_RANGES can be defined by the user, maximum amount of byte ranges a self loop byte class
+// may consist of for SM_feed_bytes() to skip runs of it using SIMD instructions
+#ifndef SM_BYTE_RUN_RANGES
+#define SM_BYTE_RUN_RANGES 4
+#endif
+
+// define for counting how often each transition fires, how often each state is entered and how long it stays active,
+// only compiled state machines are counted, see SM_stats_snapshot()
+#ifdef SM_STATS
+
+// SM_STATS_BUCKETS can be defined by the user, amount of power of two buckets in the dwell time histograms
+#ifndef SM_STATS_BUCKETS
+#define SM_STATS_BUCKETS 40
+#endif
+
+#endif
+
+// define for timing every call of a guard, trigger, effect or action, see SM_Profile_summarize() and SM_profile_report(),
+// the timings are stored in the states and transitions so SM_static_*() definitions are no longer const
+#ifdef SM_PROFILE
+#include <stdio.h>
+
+// SM_PROFILE_BUCKETS can be defined by the user, amount of power of two buckets in the duration histograms
+#ifndef SM_PROFILE_BUCKETS
+#define SM_PROFILE_BUCKETS 48
+#endif
+
+// SM_PROFILE_TIME can be defined by the user, returns a timestamp in any unit, defaults to the time stamp counter on x86
+// and to SM_TIME_NS() elsewhere
+#ifndef SM_PROFILE_TIME
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SM_PROFILE_TIME() __builtin_ia32_rdtsc()
+#else
+#define SM_PROFILE_TIME() SM_TIME_NS()
+#endif
+#endif
+
+#endif
+
+// SM_TIME_NS can be defined by the user, returns a monotonic timestamp in nanoseconds.
+// the default uses clock_gettime(), which requires _POSIX_C_SOURCE to be defined when compiling with -std=c99
+#if (defined(SM_STATS) || defined(SM_TRACE_BINARY) || defined(SM_PROFILE)) && !defined(SM_TIME_NS)
+#include <time.h>
+#define SM_TIME_NS() SM_time_ns()
+#define SM_TIME_NS_DEFAULT
+#endif
+
+// SIMD instructions are used when enabled by the compiler, define SM_NO_SIMD to always use scalar code
+#ifndef SM_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SM_AVX2
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SM_SSE2
+#endif
+#endif
+
 typedef void (*SM_ActionCallback)(void* user_context);
+typedef void (*SM_ByteCallback)(void* user_context, const uint8_t* bytes, size_t length);
+
+// outgoing transitions of a state as packed by SM_compile(), partitioned by how they can fire
+typedef struct{
+  void** transitions;
+  size_t guard_count;         // guard without trigger, checked first during SM_step()
+  size_t unconditional_count; // without guard or trigger, the first one fires during SM_step() if no guard passed
+  size_t trigger_count;       // with trigger but without event id, only checked during SM_notify()
+  size_t event_count;         // with event id sorted by id, only checked during SM_notify_id()
+  size_t timeout_count;       // with timeout sorted by duration, armed when the state is entered
+  size_t byte_count;          // with byte class, only taken during SM_feed_bytes()
+  uint8_t* byte_table;        // index + 1 of the byte transition taken for each byte value, 0 if none or NULL if byte_count is 0
+  uint8_t byte_run;           // index + 1 of a byte transition looping back without actions, runs of it are taken at once
+  uint8_t byte_run_range_count;                   // 0 if its bytes don't fit in byte_run_ranges
+  uint8_t byte_run_ranges[SM_BYTE_RUN_RANGES][2]; // first and last byte of each range the run is taken on
+} SM_TransitionTable;
+
+#ifdef SM_PROFILE
+typedef struct{
+  uint64_t count;
+  uint64_t total;
+  uint64_t min_inverted; // ~min so a zero initialized profile has no minimum yet
+  uint64_t buckets[SM_PROFILE_BUCKETS]; // buckets[i] counts durations of less than 2^(i+1) and atleast 2^i, the last bucket any longer one
+} SM_Profile;
+
+typedef struct{
+  uint64_t count;
+  uint64_t min;
+  double mean;
+  uint64_t p99; // upper bound of the bucket containing the 99th percentile
+} SM_ProfileSummary;
+#endif
+
+#ifdef SM_STATS
+typedef struct{
+  uint64_t enter_count;
+  uint64_t dwell[SM_STATS_BUCKETS]; // dwell[i] counts stays of less than 2^(i+1) ns and atleast 2^i ns, the last bucket any longer stay
+} SM_StateStats;
+#endif
 
 typedef struct{
   SM_ActionCallback enter_action;
   SM_ActionCallback do_action;
   SM_ActionCallback exit_action;
   const char* trace_name;
+#ifdef SM_CODEGEN
+  const char* enter_action_name;
+  const char* do_action_name;
+  const char* exit_action_name;
+#endif
+  void* parent;
   void* transition;
+  void* last_transition;
+  void** exit_path; // set by SM_compile(), the state and its ancestors with an exit action, innermost first
+  uint16_t exit_count;
+  uint16_t depth; // amount of states from the root down to this one
+  SM_TransitionTable table;
+#ifdef SM_STATS
+  SM_StateStats stats;
+#endif
+#ifdef SM_PROFILE
+  SM_Profile enter_profile;
+  SM_Profile do_profile;
+  SM_Profile exit_profile;
+#endif
+  uint16_t id;
   bool init;
 } SM_State;
 
@@ -101,6 +290,17 @@ void SM_State_set_do_action(SM_State* self, SM_ActionCallback action);
  */
 void SM_State_set_exit_action(SM_State* self, SM_ActionCallback action);
 
+/**
+ * \brief           nests the state inside a parent state
+ * \note            while a nested state is active the transitions of its parent are also checked after all of its own,
+ *                  so a transition of the parent only fires if none of the nested state fires in the same call.
+ *                  a transition exits and enters every state up to the least common ancestor of its source and target.
+ *                  state machines with nested states must be compiled using SM_compile()
+ * \param self:     state handle
+ * \param parent:   parent state handle
+ */
+void SM_State_set_parent(SM_State* self, SM_State* parent);
+
 typedef bool (*SM_GuardCallback)(void* user_context);
 typedef bool (*SM_TriggerCallback)(void* user_context, void* event);
 
@@ -108,9 +308,34 @@ typedef struct{
   SM_TriggerCallback trigger;
   SM_GuardCallback guard;
   SM_ActionCallback effect;  
+#ifdef SM_CODEGEN
+  const char* trigger_name;
+  const char* guard_name;
+  const char* effect_name;
+#endif
+  const char* trace_name;
   SM_State* source;
   SM_State* target;
   void* next_transition;
+  SM_State* lca;
+  uint16_t lca_depth;
+  SM_State** enter_path;
+  size_t enter_count;
+  uint64_t timeout;
+  const char* byte_class;
+  SM_ByteCallback byte_effect;
+#ifdef SM_STATS
+  uint64_t fire_count;
+#endif
+#ifdef SM_PROFILE
+  SM_Profile trigger_profile;
+  SM_Profile guard_profile;
+  SM_Profile effect_profile;
+#endif
+  int event;
+  uint16_t id;
+  bool has_event;
+  bool has_timeout;
   bool init;
 } SM_Transition;
 
@@ -125,6 +350,7 @@ typedef struct{
   static SM_Transition (SM_PREFIX##transition) = {0};\
   SM_Transition* const (transition) = &(SM_PREFIX##transition);\
   SM_ASSERT((transition)->init == false && "attempted redefinition of transition: "#transition);\
+  SM_Transition_set_trace_name((transition), (#transition));\
   SM_Transition_init((transition), (source_state), (target_state));\
   SM_add_transition((sm), (transition))
 
@@ -136,6 +362,14 @@ typedef struct{
  */
 void SM_Transition_init(SM_Transition* self, SM_State* source_state, SM_State* target_state);
 
+/**
+ * \brief               sets the name used for the transition in traces and generated code
+ * \note                SM_Transition_create() sets it to the name of the transition
+ * \param self:         transition handle
+ * \param trace_name:   name of the transition, must outlive the transition
+ */
+void SM_Transition_set_trace_name(SM_Transition* self, const char* trace_name);
+
 /**
  * \brief           sets the trigger callback
  * \note            trigger is called during a SM_notify() call when the source state is active and a guard is not set or the guard returns true.
@@ -160,12 +394,133 @@ void SM_Transition_set_guard(SM_Transition* self, SM_GuardCallback guard);
  */
 void SM_Transition_set_effect(SM_Transition* self, SM_ActionCallback effect);
 
+/**
+ * \brief           sets the event id of the transition
+ * \note            a transition with an event id can only be triggered by SM_notify_id() with the same id,
+ *                  its guard and trigger (if set) are then checked to refine the match
+ * \param self:     transition handle
+ * \param event:    event id
+ */
+void SM_Transition_set_event(SM_Transition* self, int event);
+
+/**
+ * \brief             sets the timeout of the transition
+ * \note              the timeout is armed when the source state is entered and disarmed when it is exited,
+ *                    once it expires the transition is triggered during SM_Timers_advance() if it has no guard or the guard returns true.
+ *                    timeouts require the state machine to be compiled and the context to have timers set,
+ *                    a timeout of a parent state keeps running while the context moves between its nested states
+ * \param self:       transition handle
+ * \param duration:   amount of ticks after entering the source state before the transition is triggered
+ */
+void SM_Transition_set_timeout(SM_Transition* self, uint64_t duration);
+
+/**
+ * \brief               sets the bytes on which the transition is taken by SM_feed_bytes()
+ * \note                a byte class lists bytes and ranges like "a-zA-Z_", a leading '^' matches every byte not listed
+ *                      and a '-' at the start or end is matched literally. 
+ *                      byte transitions can't have a trigger, guard, event id or timeout and require the state machine to be compiled,
+ *                      if the classes of multiple transitions from a state overlap the first created one is taken
+ * \param self:         transition handle
+ * \param byte_class:   byte class, must outlive the state machine
+ */
+void SM_Transition_set_byte_class(SM_Transition* self, const char* byte_class);
+
+/**
+ * \brief               sets the callback receiving the bytes a byte transition is taken on
+ * \note                called right after the effect, bytes points into the buffer passed to SM_feed_bytes().
+ *                      a transition from a state to itself without effect, exit and enter actions is taken once
+ *                      for a whole run of bytes, its byte effect is then called once with the whole run
+ * \param self:         transition handle
+ * \param byte_effect:  byte callback
+ */
+void SM_Transition_set_byte_effect(SM_Transition* self, SM_ByteCallback byte_effect);
+
+typedef struct{
+  size_t sequence;
+  void* event;
+} SM_QueueCell;
+
+typedef struct{
+  SM_QueueCell* cells;
+  size_t mask;
+  char head_padding[SM_CACHE_LINE_SIZE];
+  size_t head; // written by producers
+  char tail_padding[SM_CACHE_LINE_SIZE];
+  size_t tail; // written by the consumer
+} SM_Queue;
+
+/**
+ * \brief             initializes a bounded lock-free event queue
+ * \note              any amount of threads may post events to the queue, only one thread may dispatch them
+ * \param self:       queue handle
+ * \param cells:      memory for the queued events, must outlive the queue
+ * \param capacity:   amount of cells, must be a power of two
+ */
+void SM_Queue_init(SM_Queue* self, SM_QueueCell* cells, size_t capacity);
+
 typedef struct{
   void* user_context;
   SM_State* current_state;
+  SM_Queue* queue;
+  void* timer;
+#ifdef SM_STATS
+  uint64_t entered_at; // 0 if unknown, in which case the current stay isn't counted
+#endif
+#if defined(SM_TRACE_BINARY) || defined(SM_RECORD)
+  uint32_t id; // see SM_Context_set_id()
+#endif
+#ifdef SM_DIRTY
+  bool dirty; // guards have to be checked on the next step
+#endif
   bool halted;
 } SM_Context;
 
+// SM_TIMER_LEVELS can be defined by the user, each level covers 64 times the range of the previous one
+#ifndef SM_TIMER_LEVELS
+#define SM_TIMER_LEVELS 4
+#endif
+#define SM_TIMER_SLOTS 64
+
+// SM_TIMER_DEPTH can be defined by the user, maximum nesting depth of states in state machines with timeout transitions
+#ifndef SM_TIMER_DEPTH
+#define SM_TIMER_DEPTH 8
+#endif
+
+typedef struct{
+  void* next;
+  void* previous;
+  void** slot;
+  void* timers;
+  void* sm;
+  SM_Context* context;
+  uint64_t entered[SM_TIMER_DEPTH]; // when the current state and its ancestors were entered, indexed by depth - 1
+  uint64_t deadline;
+  size_t index;
+  bool armed;
+} SM_Timer;
+
+// hierarchical timing wheel, timers are kept in slots by deadline and only touched when they expire or cascade down a level
+typedef struct{
+  SM_Timer* slots[SM_TIMER_LEVELS][SM_TIMER_SLOTS];
+  uint64_t now;
+  size_t count;
+} SM_Timers;
+
+/**
+ * \brief         initializes the timing wheel
+ * \param self:   timers handle
+ * \param now:    current time in ticks
+ */
+void SM_Timers_init(SM_Timers* self, uint64_t now);
+
+/**
+ * \brief         advances the time of the timing wheel and triggers the timeout transitions that expired
+ * \param self:   timers handle
+ * \param now:    current time in ticks
+ * \return        amount of timers that expired
+ */
+size_t SM_Timers_advance(SM_Timers* self, uint64_t now);
+
 /**
  * \brief                 initializes the given context
  * \param self:           context handle
@@ -185,6 +540,43 @@ void SM_Context_reset(SM_Context* self);
  */
 bool SM_Context_is_halted(SM_Context* self);
 
+/**
+ * \brief         attaches an event queue to the context for use with SM_post() and SM_dispatch()
+ * \param self:   context handle
+ * \param queue:  queue handle
+ */
+void SM_Context_set_queue(SM_Context* self, SM_Queue* queue);
+
+/**
+ * \brief           queues an event for the context without blocking
+ * \note            may be called from any thread, the event must stay valid until it is dispatched
+ * \param self:     context handle
+ * \param event:    pointer to custom event type
+ * \return          true if the event was queued, false if the queue is full
+ */
+bool SM_post(SM_Context* self, void* event);
+
+// define for skipping the guards of contexts for which nothing the guards read has changed
+#ifdef SM_DIRTY
+/**
+ * \brief           marks that something the guards of the current state read has changed
+ * \note            SM_step() only checks the guards of a context once after it is invalidated or it took a transition,
+ *                  afterwards the steps of the context only call the do_action of its state until it is invalidated again
+ * \param self:     context handle
+ */
+void SM_Context_invalidate(SM_Context* self);
+#endif
+
+#if defined(SM_TRACE_BINARY) || defined(SM_RECORD)
+/**
+ * \brief           sets the id written to trace records and recorded calls of the context
+ * \note            contexts of a pool use their index instead
+ * \param self:     context handle
+ * \param id:       any id, 0 by default
+ */
+void SM_Context_set_id(SM_Context* self, uint32_t id);
+#endif
+
 #define SM_INITIAL_STATE NULL
 #define SM_FINAL_STATE NULL
 
@@ -192,9 +584,34 @@ typedef struct{
   size_t transition_count;
   SM_Transition** transitions;
   SM_Transition* initial_transition;
-  bool init;
+  SM_Transition* last_initial_transition;
+  SM_TransitionTable initial_table;
+  SM_State** states;
+  size_t state_count;
+  SM_Transition** unique_transitions;
+  size_t unique_transition_count;
+  bool compiled;
+  bool init; // set by SM_add_transition()
 } SM;
 
+/**
+ * \brief         attaches a timer to the context so timeout transitions are armed in the given timing wheel
+ * \note          a timer previously attached to the context is disarmed, 
+ *                the timeouts of the current state are armed from the current time of the timing wheel
+ * \param self:   context handle
+ * \param sm:     state machine handle the context is stepped with
+ * \param timers: timers handle
+ * \param timer:  timer handle used for this context only
+ */
+void SM_Context_set_timer(SM_Context* self, SM* sm, SM_Timers* timers, SM_Timer* timer);
+
+// memory unit used by SM_compile(), aligned for any of the tables it contains
+typedef union{
+  void* pointer;
+  size_t size;
+  double number;
+} SM_CompileMemory;
+
 /**
  * \brief       defines a new state machine
  * \note        can be defined in global and local scope
@@ -204,13 +621,108 @@ typedef struct{
   static SM (SM_PREFIX##sm) = {0};\
   static SM* (sm) = &(SM_PREFIX##sm)
 
+// SM_STATIC_CONST can be defined by the user, qualifier of the states and transitions defined by SM_static_*()
+#ifndef SM_STATIC_CONST
+#ifdef SM_PROFILE
+#define SM_STATIC_CONST
+#else
+#define SM_STATIC_CONST const
+#endif
+#endif
+
+/**
+ * \brief         refers to a state, transition or state machine defined using the SM_static_*() macros below
+ * \note          the static definitions are const (see SM_STATIC_CONST) and fully linked at compile time so they cost nothing at startup,
+ *                they must be defined in global scope and are stepped without SM_compile(), which they may not be passed to.
+ *                nested states, events and timeouts are not supported in static definitions
+ * \param name:   name of the static definition
+ */
+#define SM_static(name) ((void*)&(SM_PREFIX##name))
+
+/**
+ * \brief         declares a static state so it can be referenced before it is defined
+ * \param state:  name of the state
+ */
+#define SM_static_declare_state(state)\
+  static SM_STATIC_CONST SM_State (SM_PREFIX##state)
+
+/**
+ * \brief               declares a static transition so it can be referenced before it is defined
+ * \param transition:   name of the transition
+ */
+#define SM_static_declare_transition(transition)\
+  static SM_STATIC_CONST SM_Transition (SM_PREFIX##transition)
+
+/**
+ * \brief                     defines a const state
+ * \param state:              name of the new state
+ * \param first_transition:   first transition from this state as SM_static(transition) or NULL
+ * \param on_enter:           enter_action callback or NULL
+ * \param on_do:              do_action callback or NULL
+ * \param on_exit:            exit_action callback or NULL
+ */
+#define SM_static_state(state, first_transition, on_enter, on_do, on_exit)\
+  static SM_STATIC_CONST SM_State (SM_PREFIX##state) = {\
+    .enter_action = (on_enter), .do_action = (on_do), .exit_action = (on_exit),\
+    .trace_name = #state, .transition = (first_transition), .init = true }
+
+/**
+ * \brief                     defines a const transition
+ * \note                      transitions from the same state are checked in the order they are chained
+ * \param transition:         name of the new transition
+ * \param source_state:       state to transition from as SM_static(state) or SM_INITIAL_STATE
+ * \param target_state:       state to transition to as SM_static(state) or SM_FINAL_STATE
+ * \param next:               next transition from the same source state as SM_static(transition) or NULL
+ * \param on_trigger:         trigger callback or NULL
+ * \param on_guard:           guard callback or NULL
+ * \param on_effect:          effect callback or NULL
+ */
+#define SM_static_transition(transition, source_state, target_state, next, on_trigger, on_guard, on_effect)\
+  static SM_STATIC_CONST SM_Transition (SM_PREFIX##transition) = {\
+    .trigger = (on_trigger), .guard = (on_guard), .effect = (on_effect), .trace_name = #transition,\
+    .source = (source_state), .target = (target_state), .next_transition = (next), .init = true }
+
+/**
+ * \brief                     defines a const state machine and a handle to it that can be passed to SM_step() and SM_notify()
+ * \param sm:                 name of the new state machine handle
+ * \param first_transition:   first transition from SM_INITIAL_STATE as SM_static(transition)
+ */
+#define SM_static_def(sm, first_transition)\
+  static const SM (SM_PREFIX##sm) = { .initial_transition = (first_transition), .init = true };\
+  static SM* const (sm) = (SM*)&(SM_PREFIX##sm)
+
 /**
  * \brief               adds the given transition to the state machine linked graph structure
+ * \note                marks the state machine as initialized, so code defining it can be skipped with if(!sm->init)
  * \param self:         state machine handle
  * \param transition:   transition handle
  */
 void SM_add_transition(SM* self, SM_Transition* transition);
 
+/**
+ * \brief               defines static memory for and compiles the given state machine
+ * \note                should be called once after all states and transitions have been created and configured, 
+ *                      afterwards no transitions may be added and guards or triggers may not be set or removed.
+ * \param sm:           state machine handle
+ * \param memory_size:  size in bytes of the static memory reserved for the compiled tables
+ */
+#define SM_compile(sm, memory_size)\
+  static SM_CompileMemory SM_PREFIX##sm##_memory[((memory_size) + sizeof(SM_CompileMemory) - 1) / sizeof(SM_CompileMemory)];\
+  SM_compile_into((sm), SM_PREFIX##sm##_memory, sizeof(SM_PREFIX##sm##_memory))
+
+/**
+ * \brief           packs the outgoing transitions of every reachable state into one contiguous array
+ * \note            each state's transitions are partitioned into guarded, unconditional and triggered transitions, 
+ *                  SM_step() and SM_notify() only scan the partitions they can fire once compiled.
+ *                  every reachable state is also assigned a dense id starting at 1, 0 is used for SM_INITIAL_STATE and SM_FINAL_STATE.
+ *                  likewise every transition is assigned a dense id starting at 1 and stored in SM::unique_transitions
+ * \param self:     state machine handle
+ * \param memory:   memory in which the compiled tables are stored, must outlive the state machine and be aligned like SM_CompileMemory
+ * \param size:     size of memory in bytes
+ * \return          amount of bytes of memory used
+ */
+size_t SM_compile_into(SM* self, void* memory, size_t size);
+
 /**
  * \brief           performs one transition if possible or executes the do_action of the current state
  * \param self:     state machine handle
@@ -229,234 +741,3016 @@ bool SM_step(SM* self, SM_Context* context);
 bool SM_notify(SM* self, SM_Context* context, void* event);
 
 /**
- * \brief           runs SM_step() continuously until SM_Context_is_halted() returns false
+ * \brief           notifies transitions with the given event id from the current state of the event
+ * \note            once compiled the candidate transitions are looked up by id instead of calling every trigger
  * \param self:     state machine handle
  * \param context:  context handle
+ * \param event_id: id of the event as set with SM_Transition_set_event()
+ * \param event:    pointer to custom event type that is passed to the triggers that are checked during this call
+ * \return          true if the event has been handled, otherwise false. 
  */
-void SM_run(SM* self, SM_Context* context);
+bool SM_notify_id(SM* self, SM_Context* context, int event_id, void* event);
 
-#ifdef SM_IMPLEMENTATION
+/**
+ * \brief           performs SM_step() on an array of contexts
+ * \note            contexts may be embedded in larger user structures, stride is then the size of that structure
+ * \param self:     state machine handle
+ * \param contexts: first context handle
+ * \param count:    amount of contexts
+ * \param stride:   distance in bytes between consecutive contexts, sizeof(SM_Context) for a plain array
+ * \return          amount of contexts that were not halted
+ */
+size_t SM_step_batch(SM* self, SM_Context* contexts, size_t count, size_t stride);
 
-void SM_State_init(SM_State* self){
-  self->init = true;
-}
+/**
+ * \brief           performs SM_notify() on an array of contexts with the same event
+ * \param self:     state machine handle
+ * \param contexts: first context handle
+ * \param count:    amount of contexts
+ * \param stride:   distance in bytes between consecutive contexts, sizeof(SM_Context) for a plain array
+ * \param event:    pointer to custom event type that is passed to the triggers that are checked during this call
+ * \return          amount of contexts that handled the event
+ */
+size_t SM_notify_batch(SM* self, SM_Context* contexts, size_t count, size_t stride, void* event);
 
-void SM_State_set_trace_name(SM_State* self, const char* trace_name){
-  self->trace_name = trace_name;
-}
+/**
+ * \brief           performs SM_step() on an array of contexts as if they all step at the same time
+ * \note            all guards are checked before any transition or do_action is performed, so guards only 
+ *                  observe the state of every context before this call. The selected transitions are then
+ *                  performed in a second pass.
+ * \param self:     state machine handle
+ * \param contexts: first context handle
+ * \param count:    amount of contexts
+ * \param stride:   distance in bytes between consecutive contexts, sizeof(SM_Context) for a plain array
+ * \param next:     buffer of count transitions used to store the transitions selected in the first pass
+ * \return          amount of contexts that were not halted
+ */
+size_t SM_step_sync(SM* self, SM_Context* contexts, size_t count, size_t stride, SM_Transition** next);
 
-const char* SM_State_get_trace_name(SM_State* self){
-  if(self != SM_INITIAL_STATE){
-    if(self->trace_name == NULL) return "!state missing trace name!";
-    return self->trace_name;
-  }
-  return "initial/final";
-}
+/**
+ * \brief           runs SM_step() continuously until SM_Context_is_halted() returns false
+ * \param self:     state machine handle
+ * \param context:  context handle
+ */
+void SM_run(SM* self, SM_Context* context);
 
-void SM_State_set_enter_action(SM_State* self, SM_ActionCallback action){
-  self->enter_action = action;
-}
+/**
+ * \brief           passes queued events of the context to SM_notify() in the order they were posted
+ * \note            must only be called from the thread owning the context
+ * \param self:     state machine handle
+ * \param context:  context handle
+ * \param max:      maximum amount of events to dispatch during this call
+ * \return          amount of events taken from the queue
+ */
+size_t SM_dispatch(SM* self, SM_Context* context, size_t max);
 
-void SM_State_set_do_action(SM_State* self, SM_ActionCallback action){
-  self->do_action = action;
-}
+/**
+ * \brief           takes a byte transition for every byte of the buffer in order
+ * \note            stops early if the context halts or the current state has no byte transition for the next byte,
+ *                  guarded, unconditional and triggered transitions are not taken, the state machine must be compiled
+ * \param self:     state machine handle
+ * \param context:  context handle
+ * \param bytes:    buffer of bytes
+ * \param length:   size of the buffer in bytes
+ * \return          amount of bytes consumed
+ */
+size_t SM_feed_bytes(SM* self, SM_Context* context, const void* bytes, size_t length);
 
-void SM_State_set_exit_action(SM_State* self, SM_ActionCallback action){
-  self->exit_action = action;
-}
+#ifdef SM_STATS
+/**
+ * \brief               copies the counters of every state and transition
+ * \note                counters are updated with relaxed atomics by every transition of a compiled state machine so a snapshot
+ *                      may be taken while other threads step it, a skipped run of byte self loops counts as one transition.
+ *                      the stay in a state is only measured if the context entered it after SM_Context_init() or SM_Context_reset(),
+ *                      contexts unpacked from a pool or region don't measure stays
+ * \param self:         state machine handle, must be compiled
+ * \param states:       array of SM::state_count entries indexed by state id, may be NULL
+ * \param fire_counts:  array of SM::unique_transition_count entries indexed by transition id, may be NULL
+ */
+void SM_stats_snapshot(SM* self, SM_StateStats* states, uint64_t* fire_counts);
 
-void SM_State_enter(SM_State* self, void* user_context){
-  if(self && self->enter_action) self->enter_action(user_context); 
-}
+/**
+ * \brief           sets all counters of the state machine to 0
+ * \param self:     state machine handle, must be compiled
+ */
+void SM_stats_clear(SM* self);
+#endif
 
-void SM_State_do(SM_State* self, void* user_context){
-  if(self && self->do_action) self->do_action(user_context); 
-}
+#ifdef SM_PROFILE
+/**
+ * \brief           summarizes the durations recorded in the profile of one callback
+ * \note            durations are in the unit of SM_PROFILE_TIME(), cycles of the time stamp counter by default,
+ *                  the 99th percentile is rounded up to the next power of two minus one
+ * \param self:     profile of a state action or transition callback, like SM_State::enter_profile
+ * \return          summary, all zero if the callback was never called
+ */
+SM_ProfileSummary SM_Profile_summarize(SM_Profile* self);
 
-void SM_State_exit(SM_State* self, void* user_context){
-  if(self && self->exit_action) self->exit_action(user_context); 
-}
+/**
+ * \brief           writes the summary of every callback that has been called to a file, one line per callback
+ * \param self:     state machine handle, must be compiled
+ * \param out:      file written to
+ */
+void SM_profile_report(SM* self, FILE* out);
+#endif
 
-void SM_Transition_init(SM_Transition* self, SM_State* source, SM_State* target){
-  self->source = source;
-  self->target = target;
-  self->init = true;
-}
+#ifdef SM_TRACE_BINARY
+typedef struct{
+  uint64_t timestamp; // SM_TIME_NS() when the transition was taken
+  uint32_t duration; // ns spent in the exit actions, effects and enter actions of the transition
+  uint32_t context_id; // see SM_Context_set_id()
+  uint16_t transition_id; // see SM_compile(), 0 for transitions of uncompiled state machines
+} SM_TraceRecord;
 
-void SM_Transition_set_trigger(SM_Transition* self, SM_TriggerCallback trigger){
-  self->trigger = trigger;
-}
+typedef struct{
+  SM_TraceRecord* records;
+  size_t mask;
+  uint64_t dropped; // records lost because the ring was full
+  char head_padding[SM_CACHE_LINE_SIZE];
+  size_t head; // written by the thread the ring is attached to
+  char tail_padding[SM_CACHE_LINE_SIZE];
+  size_t tail; // written by the reader
+} SM_TraceRing;
 
-void SM_Transition_set_guard(SM_Transition* self, SM_GuardCallback guard){
-  self->guard = guard;
-}
+/**
+ * \brief             initializes a single producer single consumer ring of trace records
+ * \param self:       ring handle
+ * \param records:    memory for the records, must outlive the ring
+ * \param capacity:   amount of records, must be a power of two
+ */
+void SM_TraceRing_init(SM_TraceRing* self, SM_TraceRecord* records, size_t capacity);
 
-void SM_Transition_set_effect(SM_Transition* self, SM_ActionCallback effect){
-  self->effect = effect;
-}
+/**
+ * \brief           makes the calling thread record every transition it takes into the ring
+ * \note            records are dropped instead of waiting if the ring is full, 
+ *                  transitions taken by threads without a ring aren't recorded
+ * \param self:     ring handle, NULL to stop recording on the calling thread
+ */
+void SM_TraceRing_attach(SM_TraceRing* self);
 
-bool SM_Transition_has_trigger(SM_Transition* self){
-  return self->trigger != NULL;
-}
+/**
+ * \brief           takes the oldest records out of the ring without blocking
+ * \note            may be called from any one thread at a time, also while the attached thread keeps recording
+ * \param self:     ring handle
+ * \param records:  array receiving the records
+ * \param max:      size of the array
+ * \return          amount of records read
+ */
+size_t SM_TraceRing_read(SM_TraceRing* self, SM_TraceRecord* records, size_t max);
 
-bool SM_Transition_has_guard(SM_Transition* self){
-  return self->guard != NULL;
-}
+/**
+ * \brief           writes one line per record resolving the transition id to the trace names of the transition and its states
+ * \note            the records may have been saved and loaded in a different process, 
+ *                  as long as the state machine was created and compiled the same way
+ * \param self:     state machine handle, must be compiled
+ * \param records:  array of records
+ * \param count:    amount of records
+ * \param out:      file written to
+ */
+void SM_trace_decode(SM* self, const SM_TraceRecord* records, size_t count, FILE* out);
 
-bool SM_Transition_has_trigger_or_guard(SM_Transition* self){
+typedef struct{
+  SM* sm;
+  FILE* out;
+  char* buffer;
+  size_t size;
+  size_t used;
+  uint16_t* states; // current state id of every context, UINT16_MAX if not known yet
+  size_t context_count;
+  bool first;
+} SM_ChromeTrace;
+
+/**
+ * \brief                 starts writing trace records as Chrome trace event JSON, which can be opened in chrome://tracing or Perfetto
+ * \note                  every context is shown as a thread with a span for each state it is in and one for each transition,
+ *                        nested states are shown as nested spans. the output is buffered and written in batches
+ * \param self:           exporter handle
+ * \param sm:             state machine handle, must be compiled
+ * \param out:            file written to
+ * \param buffer:         memory for the buffered output, must outlive the exporter
+ * \param size:           size of buffer in bytes
+ * \param states:         memory for the current state of every context, must outlive the exporter
+ * \param context_count:  amount of states, contexts with a larger id only show their transitions
+ */
+void SM_ChromeTrace_init(SM_ChromeTrace* self, SM* sm, FILE* out, char* buffer, size_t size, uint16_t* states, size_t context_count);
+
+/**
+ * \brief           converts trace records into trace events
+ * \note            records of the same context must be written in the order they were recorded
+ * \param self:     exporter handle
+ * \param records:  array of records, see SM_TraceRing_read()
+ * \param count:    amount of records
+ */
+void SM_ChromeTrace_write(SM_ChromeTrace* self, const SM_TraceRecord* records, size_t count);
+
+/**
+ * \brief           writes the buffered output to the file
+ * \param self:     exporter handle
+ */
+void SM_ChromeTrace_flush(SM_ChromeTrace* self);
+
+/**
+ * \brief           completes the JSON document and flushes it, no more records may be written afterwards
+ * \param self:     exporter handle
+ */
+void SM_ChromeTrace_finish(SM_ChromeTrace* self);
+#endif
+
+#ifdef SM_RECORD
+typedef enum{
+  SM_RecordKind_STEP,
+  SM_RecordKind_NOTIFY,
+  SM_RecordKind_NOTIFY_ID,
+  SM_RecordKind_FEED_BYTES,
+} SM_RecordKind;
+
+#define SM_RECORD_MAGIC 0x4c524d53u // "SMRL" when stored in little endian
+#define SM_RECORD_VERSION 1
+
+// a log starts with this header followed by one record per call in native byte order:
+// kind (uint8_t), has event (uint8_t), context id (uint32_t), event id (int32_t, SM_RecordKind_NOTIFY_ID only),
+// length (uint32_t, SM_RecordKind_FEED_BYTES only), event_size bytes of the event if it has one and the fed bytes
+typedef struct{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t event_size;
+} SM_RecordHeader;
+
+typedef struct{
+  FILE* out;
+  uint8_t* buffer;
+  size_t size;
+  size_t used;
+  size_t event_size;
+} SM_Recorder;
+
+/**
+ * \brief               starts a log of calls written to a file in batches
+ * \note                events are passed as pointers so only their first event_size bytes are recorded,
+ *                      they must not contain pointers that are dereferenced by the triggers for a replay to work
+ * \param self:         recorder handle
+ * \param out:          file written to
+ * \param buffer:       memory for the buffered output, must outlive the recorder
+ * \param size:         size of buffer in bytes
+ * \param event_size:   size of the events passed to SM_notify() and SM_notify_id() in bytes, 0 to not record them
+ */
+void SM_Recorder_init(SM_Recorder* self, FILE* out, void* buffer, size_t size, size_t event_size);
+
+/**
+ * \brief           makes the calling thread record every call of SM_step(), SM_notify(), SM_notify_id() and SM_feed_bytes()
+ * \note            calls on behalf of pools, regions, batches and executors are not recorded, 
+ *                  contexts are identified by the id set using SM_Context_set_id()
+ * \param self:     recorder handle, NULL to stop recording on the calling thread
+ */
+void SM_Recorder_attach(SM_Recorder* self);
+
+/**
+ * \brief           writes the buffered records to the file
+ * \param self:     recorder handle
+ */
+void SM_Recorder_flush(SM_Recorder* self);
+
+/**
+ * \brief           performs the recorded calls again in order on the contexts indexed by their id
+ * \note            the calling thread doesn't record the replayed calls
+ * \param self:     state machine handle the calls were recorded on
+ * \param contexts: array of contexts
+ * \param count:    amount of contexts, calls on contexts with a larger id are skipped
+ * \param log:      contents of the log file
+ * \param size:     size of the log in bytes
+ * \return          amount of records read including skipped ones, stops early at a truncated record or if the log is of another version
+ */
+size_t SM_replay(SM* self, SM_Context* contexts, size_t count, const void* log, size_t size);
+#endif
+
+typedef struct{
+  SM* sm;
+  uint16_t* states;
+  uint64_t* halted;
+  void** user_contexts;
+  size_t count;
+#ifdef SM_MMAP
+  void* mapping; // set by SM_ContextPool_open()
+  size_t mapping_size;
+#endif
+  uint64_t* active; // see SM_ContextPool_set_active()
+#ifdef SM_DIRTY
+  uint64_t* dirty; // see SM_ContextPool_set_dirty()
+#endif
+} SM_ContextPool;
+
+// amount of uint64_t words needed for the halted bitset of a pool with count contexts
+#define SM_CONTEXT_POOL_WORDS(count) (((count) + 63) / 64)
+
+/**
+ * \brief                 initializes a pool of contexts stored as separate arrays
+ * \note                  current states are stored as the 16 bit ids assigned by SM_compile(), 
+ *                        so the state machine must be compiled first. contexts of a pool have no timer, 
+ *                        so the state machine may not have timeout transitions
+ * \param self:           pool handle
+ * \param sm:             compiled state machine handle
+ * \param states:         array of count state ids
+ * \param halted:         array of SM_CONTEXT_POOL_WORDS(count) words
+ * \param user_contexts:  array of count user context pointers passed to the callbacks of each context, may be NULL
+ * \param count:          amount of contexts in the pool
+ */
+void SM_ContextPool_init(SM_ContextPool* self, SM* sm, uint16_t* states, uint64_t* halted, void** user_contexts, size_t count);
+
+/**
+ * \brief         gets the current state of a context in the pool
+ * \param self:   pool handle
+ * \param index:  index of the context
+ */
+SM_State* SM_ContextPool_get_state(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief         checks if a context in the pool is halted
+ * \param self:   pool handle
+ * \param index:  index of the context
+ */
+bool SM_ContextPool_is_halted(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief         reinitializes a context in the pool but keeps its user_context
+ * \param self:   pool handle
+ * \param index:  index of the context
+ */
+void SM_ContextPool_reset(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief         performs SM_step() on a context in the pool
+ * \param self:   pool handle
+ * \param index:  index of the context
+ */
+bool SM_ContextPool_step(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief         performs SM_notify() on a context in the pool
+ * \note          the context is woken and marked dirty even if it doesn't handle the event, as its triggers may have changed what its guards read
+ * \param self:   pool handle
+ * \param index:  index of the context
+ * \param event:  pointer to custom event type that is passed to the triggers that are checked during this call
+ */
+bool SM_ContextPool_notify(SM_ContextPool* self, size_t index, void* event);
+
+/**
+ * \brief         performs SM_step() on every context in the pool
+ * \param self:   pool handle
+ * \return        amount of contexts that were not halted
+ */
+size_t SM_ContextPool_step_all(SM_ContextPool* self);
+
+/**
+ * \brief         performs SM_notify() on every context in the pool with the same event
+ * \param self:   pool handle
+ * \param event:  pointer to custom event type that is passed to the triggers that are checked during this call
+ * \return        amount of contexts that handled the event
+ */
+size_t SM_ContextPool_notify_all(SM_ContextPool* self, void* event);
+
+/**
+ * \brief           stores which contexts of the pool are runnable as a bitset, marking every context as runnable
+ * \note            once set, a step that neither takes a transition nor calls a do_action parks the context,
+ *                  it becomes runnable again when it is notified, reset or woken with SM_ContextPool_wake()
+ * \param self:     pool handle
+ * \param active:   memory of SM_CONTEXT_POOL_WORDS(count) words, must outlive the pool
+ */
+void SM_ContextPool_set_active(SM_ContextPool* self, uint64_t* active);
+
+/**
+ * \brief           makes a parked context of the pool runnable again
+ * \note            guards of parked contexts aren't checked, so contexts have to be woken when the data their guards read changes
+ * \param self:     pool handle with an active bitset
+ * \param index:    index of the context
+ */
+void SM_ContextPool_wake(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief           checks if a context in the pool is parked
+ * \param self:     pool handle
+ * \param index:    index of the context
+ * \return          false if the pool has no active bitset
+ */
+bool SM_ContextPool_is_parked(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief           performs SM_step() on every runnable context in the pool
+ * \note            the cost only depends on the amount of runnable contexts and the size of the bitset
+ * \param self:     pool handle with an active bitset
+ * \return          amount of contexts stepped
+ */
+size_t SM_ContextPool_step_active(SM_ContextPool* self);
+
+#ifdef SM_DIRTY
+/**
+ * \brief         stores the dirty flags of the contexts in the pool as a bitset, marking every context as dirty
+ * \note          without a dirty bitset contexts of the pool are always dirty
+ * \param self:   pool handle
+ * \param dirty:  memory of SM_CONTEXT_POOL_WORDS(count) words, must outlive the pool
+ */
+void SM_ContextPool_set_dirty(SM_ContextPool* self, uint64_t* dirty);
+
+/**
+ * \brief         SM_Context_invalidate() for a context in the pool
+ * \param self:   pool handle with a dirty bitset
+ * \param index:  index of the context
+ */
+void SM_ContextPool_invalidate(SM_ContextPool* self, size_t index);
+
+/**
+ * \brief         performs SM_step() on every dirty context in the pool
+ * \note          unlike SM_ContextPool_step_all() the do_actions of clean contexts are not called, 
+ *                the cost only depends on the amount of dirty contexts and the size of the bitset
+ * \param self:   pool handle with a dirty bitset
+ * \return        amount of contexts stepped
+ */
+size_t SM_ContextPool_step_dirty(SM_ContextPool* self);
+#endif
+
+/**
+ * \brief           hashes the compiled structure of the state machine
+ * \note            state and transition ids only mean the same in two processes if their state machines have the same fingerprint,
+ *                  it changes when states or transitions are added, removed, reordered or renamed
+ * \param self:     state machine handle, must be compiled
+ * \return          64 bit FNV-1a hash of the states and transitions
+ */
+uint64_t SM_fingerprint(SM* self);
+
+// amount of bytes written by SM_Context_serialize()
+#define SM_CONTEXT_SERIALIZED_SIZE 3
+
+/**
+ * \brief           encodes the current state of the context as its id and the halted flag
+ * \note            the encoding doesn't depend on the byte order, user context, queue and timer are not included
+ * \param self:     state machine handle, must be compiled
+ * \param context:  context handle
+ * \param buffer:   memory written to
+ * \param size:     size of buffer in bytes, atleast SM_CONTEXT_SERIALIZED_SIZE
+ * \return          amount of bytes written
+ */
+size_t SM_Context_serialize(SM* self, SM_Context* context, void* buffer, size_t size);
+
+/**
+ * \brief           restores the current state of the context encoded by SM_Context_serialize()
+ * \note            enter actions are not called, timeout transitions of the restored state are armed again if the context has a timer
+ * \param self:     state machine handle, must be compiled
+ * \param context:  initialized context handle
+ * \param buffer:   encoded context
+ * \param size:     size of buffer in bytes
+ * \return          false if the buffer is too small or doesn't encode a state of this state machine, the context is unchanged then
+ */
+bool SM_Context_deserialize(SM* self, SM_Context* context, const void* buffer, size_t size);
+
+#define SM_POOL_FILE_MAGIC 0x50434d53u // "SMCP" when stored in little endian, files of the other byte order don't match
+#define SM_POOL_FILE_VERSION 1
+
+// a pool file is this header followed by the halted bitset and the state ids of the pool, all in native byte order
+typedef struct{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fingerprint; // see SM_fingerprint()
+  uint64_t count;
+  uint64_t reserved;
+} SM_PoolFileHeader;
+
+/**
+ * \brief           size of the pool file of a pool with the given amount of contexts
+ * \param count:    amount of contexts
+ * \return          size in bytes
+ */
+size_t SM_ContextPool_file_size(size_t count);
+
+/**
+ * \brief           writes the states and halted flags of every context in the pool as a flat pool file
+ * \note            the memory can be written to disk as is or be a writable mapping of the file
+ * \param self:     pool handle
+ * \param memory:   memory written to, aligned to 8 bytes
+ * \param size:     size of memory in bytes, atleast SM_ContextPool_file_size()
+ * \return          amount of bytes written
+ */
+size_t SM_ContextPool_save_file(SM_ContextPool* self, void* memory, size_t size);
+
+/**
+ * \brief           restores every context of the pool from a pool file
+ * \note            enter actions are not called, the user contexts of the pool are kept
+ * \param self:     pool handle
+ * \param memory:   pool file contents, aligned to 8 bytes
+ * \param size:     size of memory in bytes
+ * \return          false if the file is truncated, has another version, state machine fingerprint or amount of contexts
+ *                  or contains an invalid state id, the pool may be partially restored then
+ */
+bool SM_ContextPool_load_file(SM_ContextPool* self, const void* memory, size_t size);
+
+/**
+ * \brief                 initializes a pool whose states and halted flags are stored in a pool file in memory, without copying them
+ * \note                  if the memory is zeroed a new pool file is created in it with every context in SM_INITIAL_STATE,
+ *                        otherwise it must be a valid pool file of this state machine and amount of contexts and the pool resumes from it.
+ *                        every change to the pool is written to the memory directly
+ * \param self:           pool handle
+ * \param sm:             state machine handle, must be compiled
+ * \param memory:         memory of the pool file, aligned to 8 bytes and must outlive the pool
+ * \param size:           size of memory in bytes, atleast SM_ContextPool_file_size()
+ * \param user_contexts:  array of user contexts, may be NULL
+ * \param count:          amount of contexts
+ * \return                false if the memory is too small or contains an invalid or incompatible pool file
+ */
+bool SM_ContextPool_init_file(SM_ContextPool* self, SM* sm, void* memory, size_t size, void** user_contexts, size_t count);
+
+#ifdef SM_MMAP
+/**
+ * \brief                 initializes a pool stored in a memory mapped pool file so it survives restarts without a load step
+ * \note                  the file is created if it doesn't exist, see SM_ContextPool_init_file(). 
+ *                        changes survive the process crashing, use SM_ContextPool_sync() to also survive the system crashing
+ * \param self:           pool handle
+ * \param sm:             state machine handle, must be compiled
+ * \param path:           path of the pool file
+ * \param user_contexts:  array of user contexts, may be NULL
+ * \param count:          amount of contexts
+ * \return                false if the file can't be opened or mapped or contains an invalid or incompatible pool file
+ */
+bool SM_ContextPool_open(SM_ContextPool* self, SM* sm, const char* path, void** user_contexts, size_t count);
+
+/**
+ * \brief         writes the changes to the pool file to disk and waits for it to finish
+ * \param self:   pool handle opened by SM_ContextPool_open()
+ * \return        false if writing failed
+ */
+bool SM_ContextPool_sync(SM_ContextPool* self);
+
+/**
+ * \brief         unmaps the pool file, the pool can't be used afterwards
+ * \param self:   pool handle opened by SM_ContextPool_open()
+ */
+void SM_ContextPool_close(SM_ContextPool* self);
+#endif
+
+typedef struct{
+  void* user_context;
+  SM** regions;
+  SM_State** current_states;
+  size_t region_count;
+  uint64_t halted;
+} SM_RegionContext;
+
+// maximum amount of regions in a SM_RegionContext
+#define SM_MAX_REGIONS 64
+
+/**
+ * \brief                 initializes a context which runs multiple state machines as orthogonal regions
+ * \note                  each region is a separate state machine with its own initial transition, 
+ *                        the active state of every region is stored in current_states.
+ *                        regions have no timer, so their state machines may not have timeout transitions
+ * \param self:           region context handle
+ * \param regions:        array of region_count state machine handles
+ * \param current_states: array of region_count states
+ * \param region_count:   amount of regions, at most SM_MAX_REGIONS
+ * \param user_context:   custom pointer which will be passed to the callbacks of all regions
+ */
+void SM_RegionContext_init(SM_RegionContext* self, SM** regions, SM_State** current_states, size_t region_count, void* user_context);
+
+/**
+ * \brief         checks if all regions of the context are halted
+ * \param self:   region context handle
+ */
+bool SM_RegionContext_is_halted(SM_RegionContext* self);
+
+/**
+ * \brief         performs SM_step() for every region that is not halted
+ * \param self:   region context handle
+ * \return        true if any region was not halted
+ */
+bool SM_RegionContext_step(SM_RegionContext* self);
+
+/**
+ * \brief         performs SM_notify() for every region that is not halted
+ * \param self:   region context handle
+ * \param event:  pointer to custom event type that is passed to the triggers that are checked during this call
+ * \return        true if the event has been handled by any region
+ */
+bool SM_RegionContext_notify(SM_RegionContext* self, void* event);
+
+/**
+ * \brief           performs SM_notify_id() for every region that is not halted
+ * \param self:     region context handle
+ * \param event_id: id of the event as set with SM_Transition_set_event()
+ * \param event:    pointer to custom event type that is passed to the triggers that are checked during this call
+ * \return          true if the event has been handled by any region
+ */
+bool SM_RegionContext_notify_id(SM_RegionContext* self, int event_id, void* event);
+
+#ifdef SM_CODEGEN
+
+// SM_CODEGEN_MAX_CALLBACKS can be defined by the user, amount of distinct callback names SM_codegen() declares only once
+#ifndef SM_CODEGEN_MAX_CALLBACKS
+#define SM_CODEGEN_MAX_CALLBACKS 256
+#endif
+
+// used by the SM_State_set_*_action() and SM_Transition_set_*() macros defined at the end of this header,
+// which record the name of the callback expression along with the callback
+void SM_State_set_enter_action_named(SM_State* self, SM_ActionCallback action, const char* name);
+void SM_State_set_do_action_named(SM_State* self, SM_ActionCallback action, const char* name);
+void SM_State_set_exit_action_named(SM_State* self, SM_ActionCallback action, const char* name);
+void SM_Transition_set_trigger_named(SM_Transition* self, SM_TriggerCallback trigger, const char* name);
+void SM_Transition_set_guard_named(SM_Transition* self, SM_GuardCallback guard, const char* name);
+void SM_Transition_set_effect_named(SM_Transition* self, SM_ActionCallback effect, const char* name);
+
+/**
+ * \brief         writes a standalone C source implementing the state machine as a switch over its states
+ * \note          the generated <name>_step(), <name>_notify() and <name>_notify_id() behave like their SM_ counterparts 
+ *                but call the guards, triggers and actions directly by name so the compiler can inline them.
+ *                every callback must be set through the setters above by its plain function name (not an expression like &f or a cast)
+ *                and have external linkage,
+ *                the state machine must be compiled and may not contain timeout or byte transitions
+ * \param self:   compiled state machine handle
+ * \param out:    file the source is written to
+ * \param name:   prefix of the generated types and functions
+ * \return        true on success, false if the state machine can not be generated in which case an #error is written to out
+ */
+bool SM_codegen(SM* self, FILE* out, const char* name);
+
+#endif // SM_CODEGEN
+
+// define for stepping arrays of contexts on multiple threads using pthreads
+#ifdef SM_EXECUTOR
+#include <pthread.h>
+
+// SM_EXECUTOR_MAX_THREADS can be defined by the user
+#ifndef SM_EXECUTOR_MAX_THREADS
+#define SM_EXECUTOR_MAX_THREADS 64
+#endif
+
+// SM_EXECUTOR_CHUNK_SIZE can be defined by the user, amount of contexts a worker claims at once
+#ifndef SM_EXECUTOR_CHUNK_SIZE
+#define SM_EXECUTOR_CHUNK_SIZE 256
+#endif
+
+// range of contexts assigned to a worker, other workers steal chunks from it once their own range is done
+typedef struct{
+  void* executor;
+  size_t index;
+  size_t next;
+  size_t end;
+  char padding[SM_CACHE_LINE_SIZE];
+} SM_ExecutorWorker;
+
+typedef struct{
+  SM* sm;
+  size_t thread_count;
+  pthread_t threads[SM_EXECUTOR_MAX_THREADS];
+  SM_ExecutorWorker workers[SM_EXECUTOR_MAX_THREADS];
+  pthread_mutex_t mutex;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  size_t generation;
+  size_t busy;
+  bool stop;
+  SM_Context* contexts;
+  size_t stride;
+  size_t stepped;
+} SM_Executor;
+
+/**
+ * \brief                 initializes the executor and starts its worker threads
+ * \param self:           executor handle
+ * \param sm:             state machine handle, must not be modified while the executor is running
+ * \param thread_count:   amount of threads stepping contexts including the thread calling SM_Executor_step_all()
+ */
+void SM_Executor_init(SM_Executor* self, SM* sm, size_t thread_count);
+
+/**
+ * \brief           performs SM_step() on an array of contexts using all threads of the executor
+ * \note            returns once every context has been stepped, callbacks are called concurrently for different contexts
+ * \param self:     executor handle
+ * \param contexts: first context handle
+ * \param count:    amount of contexts
+ * \param stride:   distance in bytes between consecutive contexts, sizeof(SM_Context) for a plain array
+ * \return          amount of contexts that were not halted
+ */
+size_t SM_Executor_step_all(SM_Executor* self, SM_Context* contexts, size_t count, size_t stride);
+
+/**
+ * \brief         stops and joins the worker threads of the executor
+ * \param self:   executor handle
+ */
+void SM_Executor_destroy(SM_Executor* self);
+#endif // SM_EXECUTOR
+
+#ifdef SM_IMPLEMENTATION
+
+void SM_State_init(SM_State* self){
+  self->init = true;
+}
+
+void SM_State_set_trace_name(SM_State* self, const char* trace_name){
+  self->trace_name = trace_name;
+}
+
+const char* SM_State_get_trace_name(SM_State* self){
+  if(self != SM_INITIAL_STATE){
+    if(self->trace_name == NULL) return "!state missing trace name!";
+    return self->trace_name;
+  }
+  return "initial/final";
+}
+
+void SM_State_set_enter_action(SM_State* self, SM_ActionCallback action){
+  self->enter_action = action;
+}
+
+void SM_State_set_do_action(SM_State* self, SM_ActionCallback action){
+  self->do_action = action;
+}
+
+void SM_State_set_exit_action(SM_State* self, SM_ActionCallback action){
+  self->exit_action = action;
+}
+
+void SM_State_set_parent(SM_State* self, SM_State* parent){
+  self->parent = parent;
+}
+
+#ifdef SM_TIME_NS_DEFAULT
+uint64_t SM_time_ns(void){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+#endif
+
+#if defined(SM_STATS) || defined(SM_PROFILE)
+// index of the highest set bit, clamped to the last bucket
+size_t SM_log2_bucket(uint64_t value, size_t bucket_count){
+#if defined(__GNUC__) || defined(__clang__)
+  size_t bucket = 63 - (size_t)__builtin_clzll(value | 1);
+#else
+  size_t bucket = 0;
+  while(value >>= 1) bucket++;
+#endif
+  return bucket < bucket_count ? bucket : bucket_count - 1;
+}
+#endif
+
+#ifdef SM_PROFILE
+void SM_Profile_record(SM_Profile* self, uint64_t start){
+  uint64_t duration = SM_PROFILE_TIME() - start;
+  SM_ATOMIC_FETCH_ADD_RELAXED(&self->count, 1);
+  SM_ATOMIC_FETCH_ADD_RELAXED(&self->total, duration);
+  SM_ATOMIC_FETCH_ADD_RELAXED(&self->buckets[SM_log2_bucket(duration, SM_PROFILE_BUCKETS)], 1);
+  uint64_t min_inverted = SM_ATOMIC_LOAD_RELAXED(&self->min_inverted);
+  while(~duration > min_inverted && !SM_ATOMIC_CAS_RELAXED(&self->min_inverted, &min_inverted, ~duration));
+}
+
+// times the call if SM_PROFILE is defined
+#define SM_PROFILED(profile, call) do{\
+    uint64_t SM_profile_start = SM_PROFILE_TIME();\
+    call;\
+    SM_Profile_record((profile), SM_profile_start);\
+  }while(0)
+#else
+#define SM_PROFILED(profile, call) call
+#endif
+
+void SM_State_enter(SM_State* self, void* user_context){
+  if(self && self->enter_action) SM_PROFILED(&self->enter_profile, self->enter_action(user_context));
+}
+
+void SM_State_do(SM_State* self, void* user_context){
+  if(self && self->do_action) SM_PROFILED(&self->do_profile, self->do_action(user_context));
+}
+
+void SM_State_exit(SM_State* self, void* user_context){
+  if(self && self->exit_action) SM_PROFILED(&self->exit_profile, self->exit_action(user_context));
+}
+
+void SM_Transition_init(SM_Transition* self, SM_State* source, SM_State* target){
+  self->source = source;
+  self->target = target;
+  self->init = true;
+}
+
+void SM_Transition_set_trace_name(SM_Transition* self, const char* trace_name){
+  self->trace_name = trace_name;
+}
+
+void SM_Transition_set_trigger(SM_Transition* self, SM_TriggerCallback trigger){
+  self->trigger = trigger;
+}
+
+void SM_Transition_set_guard(SM_Transition* self, SM_GuardCallback guard){
+  self->guard = guard;
+}
+
+void SM_Transition_set_effect(SM_Transition* self, SM_ActionCallback effect){
+  self->effect = effect;
+}
+
+void SM_Transition_set_event(SM_Transition* self, int event){
+  self->event = event;
+  self->has_event = true;
+}
+
+void SM_Transition_set_byte_class(SM_Transition* self, const char* byte_class){
+  self->byte_class = byte_class;
+}
+
+void SM_Transition_set_byte_effect(SM_Transition* self, SM_ByteCallback byte_effect){
+  self->byte_effect = byte_effect;
+}
+
+void SM_Transition_set_timeout(SM_Transition* self, uint64_t duration){
+  self->timeout = duration;
+  self->has_timeout = true;
+}
+
+bool SM_Transition_has_trigger(SM_Transition* self){
+  return self->trigger != NULL;
+}
+
+bool SM_Transition_has_event(SM_Transition* self){
+  return self->has_event;
+}
+
+bool SM_Transition_has_timeout(SM_Transition* self){
+  return self->has_timeout;
+}
+
+bool SM_Transition_has_byte_class(SM_Transition* self){
+  return self->byte_class != NULL;
+}
+
+bool SM_Transition_is_eventless(SM_Transition* self){
+  return !SM_Transition_has_trigger(self) && !SM_Transition_has_event(self) && !SM_Transition_has_timeout(self) &&
+    !SM_Transition_has_byte_class(self);
+}
+
+bool SM_Transition_has_guard(SM_Transition* self){
+  return self->guard != NULL;
+}
+
+bool SM_Transition_has_trigger_or_guard(SM_Transition* self){
   return SM_Transition_has_trigger(self) || SM_Transition_has_guard(self);
 }
 
-bool SM_Transition_check_guard(SM_Transition* self, void* user_context){
-  if(self->guard) 
-    return self->guard(user_context);
-  return false;
+bool SM_Transition_check_guard(SM_Transition* self, void* user_context){
+  bool result = false;
+  if(self->guard) 
+    SM_PROFILED(&self->guard_profile, result = self->guard(user_context));
+  return result;
+}
+
+bool SM_Transition_check_trigger(SM_Transition* self, void* user_context, void* event){
+  bool result = false;
+  if(self->trigger) 
+    SM_PROFILED(&self->trigger_profile, result = self->trigger(user_context, event));
+  return result;
+}
+
+void SM_Transition_apply_effect(SM_Transition* self, void* user_context){
+  if(self->effect) SM_PROFILED(&self->effect_profile, self->effect(user_context));
+}
+
+void SM_Transition_add_to_chain(SM_Transition* current, SM_Transition* new_transition){
+  while(current->next_transition != NULL){
+    current = current->next_transition;
+  }
+  current->next_transition = new_transition;
+}
+
+void SM_State_add_transition(SM_State* self, SM_Transition* new_transition){
+  if(self->transition == NULL){
+    self->transition = new_transition;
+  }else{
+    ((SM_Transition*)self->last_transition)->next_transition = new_transition;
+  }
+  self->last_transition = new_transition;
+}
+
+void SM_Queue_init(SM_Queue* self, SM_QueueCell* cells, size_t capacity){
+  SM_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0 && "queue capacity must be a power of two");
+  for(size_t i = 0; i < capacity; ++i){
+    cells[i].sequence = i;
+    cells[i].event = NULL;
+  }
+  self->cells = cells;
+  self->mask = capacity - 1;
+  self->head = 0;
+  self->tail = 0;
+}
+
+// each cell's sequence tells whose turn it is: equal to the position when free
+// for a producer and position + 1 when filled for the consumer
+bool SM_Queue_push(SM_Queue* self, void* event){
+  size_t position = SM_ATOMIC_LOAD_RELAXED(&self->head);
+  SM_QueueCell* cell;
+  for(;;){
+    cell = &self->cells[position & self->mask];
+    size_t sequence = SM_ATOMIC_LOAD_ACQUIRE(&cell->sequence);
+    ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+    if(difference == 0){
+      if(SM_ATOMIC_CAS_RELAXED(&self->head, &position, position + 1)) break;
+    }else if(difference < 0){
+      return false;
+    }else{
+      position = SM_ATOMIC_LOAD_RELAXED(&self->head);
+    }
+  }
+  cell->event = event;
+  SM_ATOMIC_STORE_RELEASE(&cell->sequence, position + 1);
+  return true;
+}
+
+bool SM_Queue_pop(SM_Queue* self, void** event){
+  size_t position = self->tail;
+  SM_QueueCell* cell = &self->cells[position & self->mask];
+  if(SM_ATOMIC_LOAD_ACQUIRE(&cell->sequence) != position + 1) return false;
+  *event = cell->event;
+  SM_ATOMIC_STORE_RELEASE(&cell->sequence, position + self->mask + 1);
+  self->tail = position + 1;
+  return true;
+}
+
+SM_TransitionTable* SM_get_transition_table(SM* self, SM_Context* context){
+  if(context->current_state == SM_INITIAL_STATE){
+    return &self->initial_table;
+  }
+  return &context->current_state->table;
+}
+
+SM_Transition** SM_TransitionTable_get_bytes(SM_TransitionTable* self){
+  return (SM_Transition**) self->transitions + self->guard_count + self->unconditional_count + 
+    self->trigger_count + self->event_count + self->timeout_count;
+}
+
+void SM_Timers_init(SM_Timers* self, uint64_t now){
+  for(size_t level = 0; level < SM_TIMER_LEVELS; ++level){
+    for(size_t slot = 0; slot < SM_TIMER_SLOTS; ++slot){
+      self->slots[level][slot] = NULL;
+    }
+  }
+  self->now = now;
+  self->count = 0;
+}
+
+void SM_Timers_insert(SM_Timers* self, SM_Timer* timer){
+  uint64_t delta = timer->deadline - self->now;
+  size_t level = 0;
+  while(level + 1 < SM_TIMER_LEVELS && delta >= (uint64_t)1 << (6 * (level + 1))) level++;
+  size_t slot = (timer->deadline >> (6 * level)) & (SM_TIMER_SLOTS - 1);
+  if(level + 1 == SM_TIMER_LEVELS && delta >= (uint64_t)1 << (6 * SM_TIMER_LEVELS)){
+    // beyond the range of the wheel, park in the slot cascaded last and reinsert from there
+    slot = ((self->now >> (6 * level)) + SM_TIMER_SLOTS - 1) & (SM_TIMER_SLOTS - 1);
+  }
+  timer->slot = (void**)&self->slots[level][slot];
+  timer->previous = NULL;
+  timer->next = self->slots[level][slot];
+  if(timer->next) ((SM_Timer*)timer->next)->previous = timer;
+  self->slots[level][slot] = timer;
+  timer->armed = true;
+  self->count++;
+}
+
+void SM_Timers_arm(SM_Timers* self, SM_Timer* timer, uint64_t deadline){
+  // expired deadlines fire during the next tick
+  timer->deadline = deadline > self->now ? deadline : self->now + 1;
+  SM_Timers_insert(self, timer);
+}
+
+void SM_Timers_remove(SM_Timers* self, SM_Timer* timer){
+  if(!timer->armed) return;
+  if(timer->previous) ((SM_Timer*)timer->previous)->next = timer->next;
+  else *timer->slot = timer->next;
+  if(timer->next) ((SM_Timer*)timer->next)->previous = timer->previous;
+  timer->armed = false;
+  self->count--;
+}
+
+// a timeout is counted from when the state it belongs to was entered, inherited timeouts keep running in nested states
+uint64_t SM_Timer_timeout_deadline(SM_Timer* self, SM_Transition* timeout){
+  return self->entered[timeout->source ? timeout->source->depth - 1 : 0] + timeout->timeout;
+}
+
+// arms the first timeout at or after the given deadline and index, ordered by deadline and then by duration
+void SM_Timer_arm_next(SM_Timer* self, SM_TransitionTable* table, uint64_t deadline, size_t index){
+  SM_Transition** timeouts = (SM_Transition**) table->transitions + 
+    table->guard_count + table->unconditional_count + table->trigger_count + table->event_count;
+  size_t next = table->timeout_count;
+  uint64_t next_deadline = UINT64_MAX;
+  for(size_t i = 0; i < table->timeout_count; ++i){
+    uint64_t timeout_deadline = SM_Timer_timeout_deadline(self, timeouts[i]);
+    if(timeout_deadline < deadline || (timeout_deadline == deadline && i < index)) continue;
+    if(timeout_deadline < next_deadline){
+      next = i;
+      next_deadline = timeout_deadline;
+    }
+  }
+  if(next == table->timeout_count) return;
+  self->index = next;
+  SM_Timers_arm(self->timers, self, next_deadline);
+}
+
+// disarms the timer and arms the next timeout of the current state, the states deeper than the given depth were entered now
+void SM_Timer_reset(SM_Timer* self, SM* sm, SM_Context* context, size_t depth){
+  SM_Timers* timers = self->timers;
+  SM_Timers_remove(timers, self);
+  if(context->halted || !sm->compiled) return;
+  SM_TransitionTable* table = SM_get_transition_table(sm, context);
+  if(table->timeout_count == 0) return;
+  SM_State* state = context->current_state;
+  size_t levels = state ? state->depth : 1;
+  SM_ASSERT(levels <= SM_TIMER_DEPTH && "states with timeouts nested deeper than SM_TIMER_DEPTH");
+  for(size_t level = depth; level < levels; ++level) self->entered[level] = timers->now;
+  self->sm = sm;
+  // inherited timeouts that expired while their guard returned false are not armed again
+  SM_Timer_arm_next(self, table, timers->now, 0);
+}
+
+void SM_Context_init(SM_Context* self, void* user_context){
+  self->user_context = user_context;
+  self->current_state = SM_INITIAL_STATE;
+  self->queue = NULL;
+  self->timer = NULL;
+#ifdef SM_STATS
+  self->entered_at = 0;
+#endif
+#if defined(SM_TRACE_BINARY) || defined(SM_RECORD)
+  self->id = 0;
+#endif
+#ifdef SM_DIRTY
+  self->dirty = true;
+#endif
+  self->halted = false;
+}
+
+void SM_Context_reset(SM_Context* self){
+  if(self->timer) SM_Timers_remove(((SM_Timer*)self->timer)->timers, self->timer);
+  self->current_state = SM_INITIAL_STATE;
+#ifdef SM_STATS
+  self->entered_at = 0;
+#endif
+#ifdef SM_DIRTY
+  self->dirty = true;
+#endif
+  self->halted = false;
+}
+
+bool SM_Context_is_halted(SM_Context* self){
+  return self->halted;
+}
+
+void SM_Context_set_queue(SM_Context* self, SM_Queue* queue){
+  self->queue = queue;
+}
+
+void SM_Context_set_timer(SM_Context* self, SM* sm, SM_Timers* timers, SM_Timer* timer){
+  SM_Timer* previous = self->timer;
+  if(previous) SM_Timers_remove(previous->timers, previous);
+  timer->timers = timers;
+  timer->context = self;
+  timer->armed = false;
+  self->timer = timer;
+  SM_Timer_reset(timer, sm, self, 0);
+}
+
+bool SM_post(SM_Context* self, void* event){
+  SM_ASSERT(self->queue && "no queue set for context, see SM_Context_set_queue()");
+  return SM_Queue_push(self->queue, event);
+}
+
+#ifdef SM_DIRTY
+void SM_Context_invalidate(SM_Context* self){
+  self->dirty = true;
+}
+#endif
+
+#if defined(SM_TRACE_BINARY) || defined(SM_RECORD)
+void SM_Context_set_id(SM_Context* self, uint32_t id){
+  self->id = id;
+}
+#endif
+
+void _SM_init(SM* self){
+  self->init = true;
+}
+
+#ifdef SM_STATS
+// counts the transition, the states it enters and how long the context stayed in the state it leaves
+void SM_stats_record(SM_Transition* transition, SM_Context* context){
+  uint64_t now = SM_TIME_NS();
+  if(context->entered_at != 0 && context->current_state != SM_INITIAL_STATE){
+    SM_State* state = context->current_state;
+    SM_ATOMIC_FETCH_ADD_RELAXED(&state->stats.dwell[SM_log2_bucket(now - context->entered_at, SM_STATS_BUCKETS)], 1);
+  }
+  context->entered_at = now;
+  SM_ATOMIC_FETCH_ADD_RELAXED(&transition->fire_count, 1);
+  for(SM_State* state = transition->target; state != transition->lca; state = state->parent){
+    SM_ATOMIC_FETCH_ADD_RELAXED(&state->stats.enter_count, 1);
+  }
+}
+#endif
+
+#ifdef SM_TRACE_BINARY
+SM_THREAD_LOCAL SM_TraceRing* SM_trace_ring = NULL;
+
+void SM_TraceRing_init(SM_TraceRing* self, SM_TraceRecord* records, size_t capacity){
+  SM_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0 && "trace ring capacity must be a power of two");
+  self->records = records;
+  self->mask = capacity - 1;
+  self->dropped = 0;
+  self->head = 0;
+  self->tail = 0;
+}
+
+void SM_TraceRing_attach(SM_TraceRing* self){
+  SM_trace_ring = self;
+}
+
+bool SM_TraceRing_push(SM_TraceRing* self, const SM_TraceRecord* record){
+  size_t head = self->head;
+  if(head - SM_ATOMIC_LOAD_ACQUIRE(&self->tail) > self->mask){
+    SM_ATOMIC_FETCH_ADD_RELAXED(&self->dropped, 1);
+    return false;
+  }
+  self->records[head & self->mask] = *record;
+  SM_ATOMIC_STORE_RELEASE(&self->head, head + 1);
+  return true;
+}
+
+size_t SM_TraceRing_read(SM_TraceRing* self, SM_TraceRecord* records, size_t max){
+  size_t tail = self->tail;
+  size_t available = SM_ATOMIC_LOAD_ACQUIRE(&self->head) - tail;
+  size_t count = available < max ? available : max;
+  for(size_t i = 0; i < count; ++i){
+    records[i] = self->records[(tail + i) & self->mask];
+  }
+  SM_ATOMIC_STORE_RELEASE(&self->tail, tail + count);
+  return count;
+}
+
+void SM_trace_decode(SM* self, const SM_TraceRecord* records, size_t count, FILE* out){
+  SM_ASSERT(self->compiled && "decoding traces requires SM_compile()");
+  for(size_t i = 0; i < count; ++i){
+    const SM_TraceRecord* record = &records[i];
+    fprintf(out, "%llu %lu ", (unsigned long long)record->timestamp, (unsigned long)record->context_id);
+    if(record->transition_id == 0 || record->transition_id >= self->unique_transition_count){
+      fprintf(out, "unknown transition %u\n", (unsigned)record->transition_id);
+      continue;
+    }
+    SM_Transition* transition = self->unique_transitions[record->transition_id];
+    fprintf(out, "%s: '%s' -> '%s'\n",
+        transition->trace_name ? transition->trace_name : "unnamed",
+        transition->source ? SM_State_get_trace_name(transition->source) : "SM_INITIAL_STATE",
+        transition->target ? SM_State_get_trace_name(transition->target) : "SM_FINAL_STATE");
+  }
+}
+
+void SM_ChromeTrace_flush(SM_ChromeTrace* self){
+  fwrite(self->buffer, 1, self->used, self->out);
+  self->used = 0;
+}
+
+void SM_ChromeTrace_put(SM_ChromeTrace* self, const char* str){
+  for(; *str; ++str){
+    if(self->used == self->size) SM_ChromeTrace_flush(self);
+    self->buffer[self->used++] = *str;
+  }
+}
+
+void SM_ChromeTrace_put_name(SM_ChromeTrace* self, const char* name){
+  for(; *name; ++name){
+    char escaped[8] = { *name, '\0' };
+    if(*name == '"' || *name == '\\') snprintf(escaped, sizeof(escaped), "\\%c", *name);
+    else if((unsigned char)*name < 0x20) snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)*name);
+    SM_ChromeTrace_put(self, escaped);
+  }
+}
+
+// timestamps are written in microseconds
+void SM_ChromeTrace_event(SM_ChromeTrace* self, const char* name, const char* category, char phase, 
+    uint64_t timestamp, uint64_t duration, uint32_t context_id){
+  char number[64];
+  SM_ChromeTrace_put(self, self->first ? "\n" : ",\n");
+  self->first = false;
+  SM_ChromeTrace_put(self, "{\"name\":\"");
+  SM_ChromeTrace_put_name(self, name);
+  snprintf(number, sizeof(number), "\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u", 
+      category, phase, (unsigned long long)(timestamp / 1000), (unsigned)(timestamp % 1000));
+  SM_ChromeTrace_put(self, number);
+  if(phase == 'X'){
+    snprintf(number, sizeof(number), ",\"dur\":%llu.%03u", (unsigned long long)(duration / 1000), (unsigned)(duration % 1000));
+    SM_ChromeTrace_put(self, number);
+  }
+  snprintf(number, sizeof(number), ",\"pid\":1,\"tid\":%lu}", (unsigned long)context_id);
+  SM_ChromeTrace_put(self, number);
+}
+
+// begins the spans of the entered states outermost first
+void SM_ChromeTrace_enter(SM_ChromeTrace* self, SM_State* state, SM_State* lca, uint64_t timestamp, uint32_t context_id){
+  if(state == lca) return;
+  SM_ChromeTrace_enter(self, state->parent, lca, timestamp, context_id);
+  SM_ChromeTrace_event(self, SM_State_get_trace_name(state), "state", 'B', timestamp, 0, context_id);
+}
+
+void SM_ChromeTrace_init(SM_ChromeTrace* self, SM* sm, FILE* out, char* buffer, size_t size, uint16_t* states, size_t context_count){
+  SM_ASSERT(sm->compiled && "exporting traces requires SM_compile()");
+  SM_ASSERT(size > 0 && "buffer of the exporter is empty");
+  self->sm = sm;
+  self->out = out;
+  self->buffer = buffer;
+  self->size = size;
+  self->used = 0;
+  self->states = states;
+  self->context_count = context_count;
+  self->first = true;
+  for(size_t i = 0; i < context_count; ++i){
+    states[i] = UINT16_MAX;
+  }
+  SM_ChromeTrace_put(self, "{\"traceEvents\":[");
+}
+
+void SM_ChromeTrace_write(SM_ChromeTrace* self, const SM_TraceRecord* records, size_t count){
+  for(size_t i = 0; i < count; ++i){
+    const SM_TraceRecord* record = &records[i];
+    if(record->transition_id == 0 || record->transition_id >= self->sm->unique_transition_count) continue;
+    SM_Transition* transition = self->sm->unique_transitions[record->transition_id];
+    uint16_t* state_id = record->context_id < self->context_count ? &self->states[record->context_id] : NULL;
+
+    if(state_id){
+      // the first transition of a context is assumed to be taken from its own source state
+      SM_State* current = *state_id == UINT16_MAX ? transition->source : self->sm->states[*state_id];
+      for(SM_State* state = current; state != transition->lca; state = state->parent){
+        SM_ChromeTrace_event(self, SM_State_get_trace_name(state), "state", 'E', record->timestamp, 0, record->context_id);
+      }
+    }
+    SM_ChromeTrace_event(self, transition->trace_name ? transition->trace_name : "unnamed", "transition", 'X', 
+        record->timestamp, record->duration, record->context_id);
+    if(state_id){
+      SM_ChromeTrace_enter(self, transition->target, transition->lca, record->timestamp + record->duration, record->context_id);
+      *state_id = transition->target ? transition->target->id : 0;
+    }
+  }
+}
+
+void SM_ChromeTrace_finish(SM_ChromeTrace* self){
+  SM_ChromeTrace_put(self, "\n]}\n");
+  SM_ChromeTrace_flush(self);
+}
+#endif
+
+// takes the transition passing the bytes it was taken on to its byte effect
+void SM_transition_bytes(SM* self, SM_Transition* transition, SM_Context* context, const uint8_t* bytes, size_t length){
+#ifdef SM_TRACE
+  SM_TRACE_LOG_FMT("transition triggered: '%s' -> '%s'\n", 
+      SM_State_get_trace_name(transition->source),
+      SM_State_get_trace_name(transition->target));
+#endif
+#ifdef SM_STATS
+  // the counters of uncompiled state machines aren't reachable by SM_stats_snapshot() and may be const
+  if(self->compiled) SM_stats_record(transition, context);
+#endif
+#ifdef SM_TRACE_BINARY
+  uint64_t trace_start = SM_trace_ring ? SM_TIME_NS() : 0;
+#endif
+  // exit up to the least common ancestor, uncompiled state machines are flat so this is only the current state
+  SM_State* current = context->current_state;
+  if(current && current->exit_path){
+    SM_State** exit_path = (SM_State**)current->exit_path;
+    for(size_t i = 0; i < current->exit_count && exit_path[i]->depth > transition->lca_depth; ++i){
+      SM_State_exit(exit_path[i], context->user_context);
+    }
+  }else{
+    SM_State_exit(current, context->user_context);
+  }
+  SM_Transition_apply_effect(transition, context->user_context);
+  if(transition->byte_effect) transition->byte_effect(context->user_context, bytes, length);
+  if(transition->enter_path){
+    for(size_t i = 0; i < transition->enter_count; ++i){
+      SM_State_enter(transition->enter_path[i], context->user_context);
+    }
+  }else{
+    SM_State_enter(transition->target, context->user_context);
+  }
+  context->current_state = transition->target;
+#ifdef SM_DIRTY
+  context->dirty = true;
+#endif
+  if(context->current_state == SM_FINAL_STATE){
+    context->halted = true;
+  }
+  // the ancestors that weren't exited keep the time their timeouts were armed at
+  if(context->timer) SM_Timer_reset(context->timer, self, context, transition->lca_depth);
+#ifdef SM_TRACE_BINARY
+  if(SM_trace_ring){
+    SM_TraceRecord record = { .timestamp = trace_start, .duration = (uint32_t)(SM_TIME_NS() - trace_start),
+      .context_id = context->id, .transition_id = transition->id };
+    SM_TraceRing_push(SM_trace_ring, &record);
+  }
+#endif
+}
+
+void SM_transition(SM* self, SM_Transition* transition, SM_Context* context){
+  SM_transition_bytes(self, transition, context, NULL, 0);
+}
+
+void SM_Timer_expire(SM_Timer* self){
+  SM_TransitionTable* table = SM_get_transition_table(self->sm, self->context);
+  SM_Transition** timeouts = (SM_Transition**) table->transitions + 
+    table->guard_count + table->unconditional_count + table->trigger_count + table->event_count;
+  SM_Transition* transition = timeouts[self->index];
+  if(!SM_Transition_has_guard(transition) || SM_Transition_check_guard(transition, self->context->user_context)){
+    SM_transition(self->sm, transition, self->context);
+  }else{
+    // guard blocked this timeout, wait for the next one
+    SM_Timer_arm_next(self, table, SM_Timer_timeout_deadline(self, transition), self->index + 1);
+  }
+}
+
+void SM_Timers_cascade(SM_Timers* self, size_t level){
+  SM_Timer** slot = &self->slots[level][(self->now >> (6 * level)) & (SM_TIMER_SLOTS - 1)];
+  SM_Timer* timer = *slot;
+  *slot = NULL;
+  while(timer){
+    SM_Timer* next = timer->next;
+    timer->armed = false;
+    self->count--;
+    SM_Timers_insert(self, timer);
+    timer = next;
+  }
+}
+
+size_t SM_Timers_advance(SM_Timers* self, uint64_t now){
+  size_t expired = 0;
+  while(self->now < now){
+    if(self->count == 0){
+      self->now = now;
+      break;
+    }
+    self->now++;
+
+    // when a lower level wraps around the next slot of the level above moves down, highest level first
+    size_t levels = 1;
+    while(levels < SM_TIMER_LEVELS && ((self->now >> (6 * (levels - 1))) & (SM_TIMER_SLOTS - 1)) == 0) levels++;
+    for(size_t level = levels - 1; level > 0; --level){
+      SM_Timers_cascade(self, level);
+    }
+
+    SM_Timer** slot = &self->slots[0][self->now & (SM_TIMER_SLOTS - 1)];
+    while(*slot){
+      SM_Timer* timer = *slot;
+      SM_Timers_remove(self, timer);
+      SM_Timer_expire(timer);
+      expired++;
+    }
+  }
+  return expired;
+}
+
+void SM_add_transition(SM* self, SM_Transition* transition){
+  SM_ASSERT(!self->compiled && "transitions can't be added after SM_compile()");
+  _SM_init(self);
+  if(transition->source != SM_INITIAL_STATE){
+    SM_State_add_transition(transition->source, transition);
+  }else{
+    if(self->initial_transition == NULL){
+      self->initial_transition = transition;
+    }else{
+      self->last_initial_transition->next_transition = transition;
+    }
+    self->last_initial_transition = transition;
+  }
+}
+
+bool SM_Transition_is_guarded(SM_Transition* self){
+  return SM_Transition_is_eventless(self) && SM_Transition_has_guard(self);
+}
+
+bool SM_Transition_is_unconditional(SM_Transition* self){
+  return SM_Transition_is_eventless(self) && !SM_Transition_has_guard(self);
+}
+
+bool SM_Transition_is_triggered(SM_Transition* self){
+  return SM_Transition_has_trigger(self) && !SM_Transition_has_event(self) && !SM_Transition_has_timeout(self);
+}
+
+bool SM_Transition_is_event(SM_Transition* self){
+  return SM_Transition_has_event(self) && !SM_Transition_has_timeout(self);
+}
+
+// stable insertion sort so transitions with the same duration keep their creation order
+void SM_compile_sort_timeouts(SM_Transition** transitions, size_t count){
+  for(size_t i = 1; i < count; ++i){
+    SM_Transition* transition = transitions[i];
+    size_t j = i;
+    for(; j > 0 && transitions[j-1]->timeout > transition->timeout; --j){
+      transitions[j] = transitions[j-1];
+    }
+    transitions[j] = transition;
+  }
+}
+
+// stable insertion sort by event id so transitions with the same id keep their creation order
+void SM_compile_sort_events(SM_Transition** transitions, size_t count){
+  for(size_t i = 1; i < count; ++i){
+    SM_Transition* transition = transitions[i];
+    size_t j = i;
+    for(; j > 0 && transitions[j-1]->event > transition->event; --j){
+      transitions[j] = transitions[j-1];
+    }
+    transitions[j] = transition;
+  }
+}
+
+// the transitions of a state are followed by those inherited from its ancestors up to, but not including, limit
+size_t SM_compile_partition(SM_Transition* chain, SM_State* ancestor, SM_State* limit, bool (*filter)(SM_Transition*), SM_Transition** transitions, size_t count, size_t capacity){
+  (void)(capacity); // only checked by SM_ASSERT
+  size_t start = count;
+  for(;;){
+    for(SM_Transition* transition = chain; transition != NULL; transition = transition->next_transition){
+      if(!filter(transition)) continue;
+      SM_ASSERT(count < capacity && "not enough memory passed to SM_compile()");
+      transitions[count++] = transition;
+    }
+    if(ancestor == NULL || ancestor == limit) break;
+    chain = ancestor->transition;
+    ancestor = ancestor->parent;
+  }
+  return count - start;
+}
+
+// the first state from the source up with an unconditional transition always takes one of its own eventless transitions,
+// returns its parent whose eventless transitions and those of its ancestors are never checked, NULL if there is none
+SM_State* SM_compile_eventless_limit(SM_Transition* chain, SM_State* ancestor){
+  for(;;){
+    for(SM_Transition* transition = chain; transition != NULL; transition = transition->next_transition){
+      if(SM_Transition_is_unconditional(transition)) return ancestor;
+    }
+    if(ancestor == NULL) return NULL;
+    chain = ancestor->transition;
+    ancestor = ancestor->parent;
+  }
+}
+
+size_t SM_compile_table(SM_TransitionTable* table, SM_Transition* chain, SM_State* ancestor, SM_Transition** transitions, size_t count, size_t capacity){
+  // SM_select_compiled() checks every guard before the first unconditional transition, so the eventless transitions
+  // of the ancestors are cut off where they would take precedence over an unconditional transition of a nested state
+  SM_State* limit = SM_compile_eventless_limit(chain, ancestor);
+  table->transitions = (void**)&transitions[count];
+  table->guard_count = SM_compile_partition(chain, ancestor, limit, SM_Transition_is_guarded, transitions, count, capacity);
+  count += table->guard_count;
+  table->unconditional_count = SM_compile_partition(chain, ancestor, limit, SM_Transition_is_unconditional, transitions, count, capacity);
+  count += table->unconditional_count;
+  table->trigger_count = SM_compile_partition(chain, ancestor, NULL, SM_Transition_is_triggered, transitions, count, capacity);
+  count += table->trigger_count;
+  table->event_count = SM_compile_partition(chain, ancestor, NULL, SM_Transition_is_event, transitions, count, capacity);
+  SM_compile_sort_events(&transitions[count], table->event_count);
+  count += table->event_count;
+  table->timeout_count = SM_compile_partition(chain, ancestor, NULL, SM_Transition_has_timeout, transitions, count, capacity);
+  SM_compile_sort_timeouts(&transitions[count], table->timeout_count);
+  count += table->timeout_count;
+  table->byte_count = SM_compile_partition(chain, ancestor, NULL, SM_Transition_has_byte_class, transitions, count, capacity);
+  SM_ASSERT(table->byte_count < 256 && "too many byte transitions from one state");
+  count += table->byte_count;
+  return count;
+}
+
+size_t SM_State_depth(SM_State* self){
+  size_t depth = 0;
+  for(; self != NULL; self = self->parent) depth++;
+  return depth;
+}
+
+// least common ancestor that contains both source and target without being either of them
+SM_State* SM_Transition_find_lca(SM_Transition* self){
+  if(self->source == SM_INITIAL_STATE || self->target == SM_FINAL_STATE) return NULL;
+  SM_State* source = self->source->parent;
+  SM_State* target = self->target->parent;
+  size_t source_depth = SM_State_depth(source);
+  size_t target_depth = SM_State_depth(target);
+  for(; source_depth > target_depth; source_depth--) source = source->parent;
+  for(; target_depth > source_depth; target_depth--) target = target->parent;
+  while(source != target){
+    source = source->parent;
+    target = target->parent;
+  }
+  return source;
+}
+
+// a byte class lists bytes and ranges like "a-zA-Z_", a leading '^' inverts it
+bool SM_byte_class_contains(const char* byte_class, uint8_t byte){
+  const uint8_t* ch = (const uint8_t*) byte_class;
+  bool inverted = *ch == '^';
+  if(inverted) ch++;
+  while(*ch){
+    if(ch[1] == '-' && ch[2] != '\0'){
+      if(byte >= ch[0] && byte <= ch[2]) return !inverted;
+      ch += 3;
+    }else{
+      if(byte == ch[0]) return !inverted;
+      ch++;
+    }
+  }
+  return inverted;
+}
+
+typedef struct{
+  char* memory;
+  size_t size;
+  size_t used;
+} SM_CompileArena;
+
+void* SM_CompileArena_alloc(SM_CompileArena* self, size_t size){
+  size = (size + sizeof(SM_CompileMemory) - 1) / sizeof(SM_CompileMemory) * sizeof(SM_CompileMemory);
+  SM_ASSERT(self->size - self->used >= size && "not enough memory passed to SM_compile()");
+  void* memory = self->memory + self->used;
+  self->used += size;
+  return memory;
+}
+
+size_t SM_compile_into(SM* self, void* memory, size_t size){
+  SM_ASSERT(self->initial_transition && "atleast one transition from SM_INITIAL_STATE must be created");
+  SM_ASSERT(!self->compiled && "state machine already compiled");
+  SM_CompileArena arena = { .memory = memory, .size = size, .used = 0 };
+
+  // the transition array grows into the remaining memory until its final size is known
+  SM_Transition** transitions = (SM_Transition**)(arena.memory + arena.used);
+  size_t capacity = (arena.size - arena.used) / sizeof(SM_Transition*);
+  size_t count = SM_compile_table(&self->initial_table, self->initial_transition, NULL, transitions, 0, capacity);
+  size_t state_count = 0;
+
+  // breadth first over the compiled transitions themselves, appending the table
+  // of every target state the first time it is encountered
+  for(size_t i = 0; i < count; ++i){
+    SM_State* state = transitions[i]->target;
+    if(state == SM_FINAL_STATE || state->table.transitions != NULL) continue;
+    SM_ASSERT(state_count < UINT16_MAX && "too many states");
+    state->id = (uint16_t)++state_count;
+    count = SM_compile_table(&state->table, state->transition, state->parent, transitions, count, capacity);
+  }
+
+  // parents that are never entered directly still get an id so every state can be found in SM::states
+  for(size_t i = 0; i < count; ++i){
+    SM_State* state = transitions[i]->target;
+    for(SM_State* parent = state ? state->parent : NULL; parent != NULL; parent = parent->parent){
+      if(parent->table.transitions != NULL || parent->id != 0) continue;
+      SM_ASSERT(state_count < UINT16_MAX && "too many states");
+      parent->id = (uint16_t)++state_count;
+    }
+  }
+  SM_CompileArena_alloc(&arena, count * sizeof(SM_Transition*));
+
+  // precompute which states each transition enters, skipping those without enter action,
+  // transitions inherited from a parent state appear multiple times but are only handled and given an id once
+  size_t unique_count = 0;
+  for(size_t i = 0; i < count; ++i){
+    SM_Transition* transition = transitions[i];
+    SM_ASSERT((!SM_Transition_has_byte_class(transition) || 
+          (!SM_Transition_has_trigger_or_guard(transition) && !SM_Transition_has_event(transition) && !SM_Transition_has_timeout(transition))) &&
+        "byte transitions can't have a trigger, guard, event id or timeout");
+    if(transition->enter_path != NULL) continue;
+    SM_ASSERT(unique_count < UINT16_MAX && "too many transitions");
+    transition->id = (uint16_t)++unique_count;
+    transition->lca = SM_Transition_find_lca(transition);
+    transition->lca_depth = (uint16_t)SM_State_depth(transition->lca);
+    size_t depth = 0;
+    for(SM_State* state = transition->target; state != transition->lca; state = state->parent){
+      if(state->enter_action) depth++;
+    }
+    transition->enter_path = SM_CompileArena_alloc(&arena, (depth > 0 ? depth : 1) * sizeof(SM_State*));
+    transition->enter_count = depth;
+    for(SM_State* state = transition->target; state != transition->lca; state = state->parent){
+      if(state->enter_action) transition->enter_path[--depth] = state;
+    }
+  }
+
+  self->states = SM_CompileArena_alloc(&arena, (state_count + 1) * sizeof(SM_State*));
+  self->states[0] = SM_INITIAL_STATE;
+  for(size_t i = 0; i < count; ++i){
+    for(SM_State* state = transitions[i]->target; state != SM_FINAL_STATE; state = state->parent){
+      self->states[state->id] = state;
+    }
+  }
+  self->state_count = state_count + 1;
+
+  // precompute which states are exited from each state, transitions then only exit those deeper than their lca
+  for(size_t id = 1; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    if(state->exit_path != NULL) continue;
+    state->depth = (uint16_t)SM_State_depth(state);
+    size_t exit_count = 0;
+    for(SM_State* ancestor = state; ancestor != NULL; ancestor = ancestor->parent){
+      if(ancestor->exit_action) exit_count++;
+    }
+    state->exit_path = SM_CompileArena_alloc(&arena, (exit_count > 0 ? exit_count : 1) * sizeof(SM_State*));
+    state->exit_count = (uint16_t)exit_count;
+    exit_count = 0;
+    for(SM_State* ancestor = state; ancestor != NULL; ancestor = ancestor->parent){
+      if(ancestor->exit_action) state->exit_path[exit_count++] = ancestor;
+    }
+  }
+
+  self->unique_transitions = SM_CompileArena_alloc(&arena, (unique_count + 1) * sizeof(SM_Transition*));
+  self->unique_transitions[0] = NULL;
+  for(size_t i = 0; i < count; ++i){
+    self->unique_transitions[transitions[i]->id] = transitions[i];
+  }
+  self->unique_transition_count = unique_count + 1;
+
+  // map every byte to the first byte transition of each state whose class contains it
+  for(size_t id = 0; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    SM_TransitionTable* table = id == 0 ? &self->initial_table : &state->table;
+    if(table->byte_count == 0) continue;
+    SM_Transition** bytes = SM_TransitionTable_get_bytes(table);
+    table->byte_table = SM_CompileArena_alloc(&arena, 256);
+    for(size_t byte = 0; byte < 256; ++byte){
+      table->byte_table[byte] = 0;
+      for(size_t i = 0; i < table->byte_count; ++i){
+        if(SM_byte_class_contains(bytes[i]->byte_class, (uint8_t)byte)){
+          table->byte_table[byte] = (uint8_t)(i + 1);
+          break;
+        }
+      }
+    }
+
+    // a self loop without actions does nothing but call its byte effect, so a run of it only has to be taken once
+    for(size_t i = 0; i < table->byte_count && state != SM_INITIAL_STATE && table->timeout_count == 0; ++i){
+      SM_Transition* transition = bytes[i];
+      // states above this one would be exited and entered again by an inherited transition
+      if(transition->target == state && transition->lca == state->parent && transition->effect == NULL &&
+          transition->enter_count == 0 && state->exit_action == NULL){
+        table->byte_run = (uint8_t)(i + 1);
+        break;
+      }
+    }
+    if(table->byte_run == 0) continue;
+    size_t range_count = 0;
+    for(size_t byte = 0; byte < 256; ++byte){
+      if(table->byte_table[byte] != table->byte_run) continue;
+      if(range_count > 0 && table->byte_run_ranges[range_count - 1][1] == byte - 1){
+        table->byte_run_ranges[range_count - 1][1] = (uint8_t)byte;
+      }else if(range_count < SM_BYTE_RUN_RANGES){
+        table->byte_run_ranges[range_count][0] = (uint8_t)byte;
+        table->byte_run_ranges[range_count][1] = (uint8_t)byte;
+        range_count++;
+      }else{
+        range_count = 0;
+        break;
+      }
+    }
+    table->byte_run_range_count = (uint8_t)range_count;
+  }
+
+  self->transitions = transitions;
+  self->transition_count = count;
+  self->compiled = true;
+  return arena.used;
+}
+
+SM_Transition* SM_get_next_transition(SM* self, SM_Context* context, SM_Transition* transition){
+  if(transition == NULL){
+    if(context->current_state == SM_INITIAL_STATE){
+      return self->initial_transition;
+    }else{
+      SM_ASSERT(context->current_state->parent == NULL && "nested states require SM_compile()");
+      return (SM_Transition*) context->current_state->transition;
+    }
+  }else{
+    return (SM_Transition*) transition->next_transition;
+  }
+}
+
+// selects the transition SM_step() fires without firing it, NULL if the do_action should be called instead
+// clean contexts can't take any transition since nothing their guards read changed since they were last checked,
+// the flag is cleared before checking so invalidations during the following transition or do_action are kept
+#ifdef SM_DIRTY
+#define SM_SELECT_SKIP_CLEAN(context) do{\
+    if(!(context)->dirty) return NULL;\
+    (context)->dirty = false;\
+  }while(0)
+#else
+#define SM_SELECT_SKIP_CLEAN(context) do{}while(0)
+#endif
+
+SM_Transition* SM_select_compiled(SM* self, SM_Context* context){
+  SM_SELECT_SKIP_CLEAN(context);
+  SM_TransitionTable* table = SM_get_transition_table(self, context);
+  SM_Transition** transitions = (SM_Transition**) table->transitions;
+
+  // check all guards without triggers first
+  for(size_t i = 0; i < table->guard_count; ++i){
+    if(SM_Transition_check_guard(transitions[i], context->user_context)){
+      return transitions[i];
+    }
+  }
+
+  // the first transition without triggers and guards always fires
+  if(table->unconditional_count > 0){
+    return transitions[table->guard_count];
+  }
+  return NULL;
+}
+
+void SM_step_selected(SM* self, SM_Context* context, SM_Transition* transition){
+  if(transition){
+    SM_transition(self, transition, context);
+  }else{
+    SM_State_do(context->current_state, context->user_context);
+  }
+}
+
+bool SM_step_compiled(SM* self, SM_Context* context){
+  SM_step_selected(self, context, SM_select_compiled(self, context));
+  return true;
+}
+
+bool SM_notify_compiled(SM* self, SM_Context* context, void* event){
+  SM_TransitionTable* table = SM_get_transition_table(self, context);
+  SM_Transition** transitions = (SM_Transition**) table->transitions + table->guard_count + table->unconditional_count;
+
+  for(size_t i = 0; i < table->trigger_count; ++i){
+    if( (!SM_Transition_has_guard(transitions[i]) || SM_Transition_check_guard(transitions[i], context->user_context)) &&
+        SM_Transition_check_trigger(transitions[i], context->user_context, event))
+    {
+      SM_transition(self, transitions[i], context);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SM_notify_id_compiled(SM* self, SM_Context* context, int event_id, void* event){
+  SM_TransitionTable* table = SM_get_transition_table(self, context);
+  SM_Transition** transitions = (SM_Transition**) table->transitions + 
+    table->guard_count + table->unconditional_count + table->trigger_count;
+
+  // binary search for the first transition with the given id
+  size_t low = 0, high = table->event_count;
+  while(low < high){
+    size_t middle = low + (high - low) / 2;
+    if(transitions[middle]->event < event_id) low = middle + 1;
+    else high = middle;
+  }
+
+  for(size_t i = low; i < table->event_count && transitions[i]->event == event_id; ++i){
+    if( (!SM_Transition_has_guard(transitions[i]) || SM_Transition_check_guard(transitions[i], context->user_context)) &&
+        (!SM_Transition_has_trigger(transitions[i]) || SM_Transition_check_trigger(transitions[i], context->user_context, event)))
+    {
+      SM_transition(self, transitions[i], context);
+      return true;
+    }
+  }
+  return false;
+}
+
+SM_Transition* SM_select_chain(SM* self, SM_Context* context){
+  SM_SELECT_SKIP_CLEAN(context);
+  // check all guards without triggers first
+  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
+      transition != NULL; 
+      transition = SM_get_next_transition(self, context, transition))
+  {
+    SM_ASSERT(transition->source == context->current_state && "transition not valid for current state");
+    if(SM_Transition_is_eventless(transition) &&
+        SM_Transition_check_guard(transition, context->user_context))
+    {
+      return transition;
+    }
+  }
+
+  // check any transitions without triggers and guards
+  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
+      transition != NULL; 
+      transition = SM_get_next_transition(self, context, transition))
+  {
+    SM_ASSERT(transition->source == context->current_state && "transition not valid for current state");
+    if(SM_Transition_is_unconditional(transition))
+    {
+      return transition;
+    }
+  }
+  return NULL;
+}
+
+bool SM_step_chain(SM* self, SM_Context* context){
+  SM_step_selected(self, context, SM_select_chain(self, context));
+  return true;
+}
+
+bool SM_notify_chain(SM* self, SM_Context* context, void* event){
+  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
+      transition != NULL; 
+      transition = SM_get_next_transition(self, context, transition))
+  {
+    SM_ASSERT(transition->source == context->current_state);
+    if( SM_Transition_is_triggered(transition) &&
+        (!SM_Transition_has_guard(transition) || SM_Transition_check_guard(transition, context->user_context)) &&
+        SM_Transition_check_trigger(transition, context->user_context, event))
+    {
+      SM_transition(self, transition, context);
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef SM_RECORD
+SM_THREAD_LOCAL SM_Recorder* SM_recorder = NULL;
+
+void SM_Recorder_flush(SM_Recorder* self){
+  fwrite(self->buffer, 1, self->used, self->out);
+  self->used = 0;
+}
+
+void SM_Recorder_write(SM_Recorder* self, const void* data, size_t length){
+  if(length > self->size - self->used) SM_Recorder_flush(self);
+  if(length > self->size){
+    fwrite(data, 1, length, self->out);
+    return;
+  }
+  memcpy(self->buffer + self->used, data, length);
+  self->used += length;
+}
+
+void SM_Recorder_init(SM_Recorder* self, FILE* out, void* buffer, size_t size, size_t event_size){
+  SM_ASSERT(event_size <= SM_RECORD_MAX_EVENT_SIZE && "events too large to record, see SM_RECORD_MAX_EVENT_SIZE");
+  self->out = out;
+  self->buffer = buffer;
+  self->size = size;
+  self->used = 0;
+  self->event_size = event_size;
+  SM_RecordHeader header = { .magic = SM_RECORD_MAGIC, .version = SM_RECORD_VERSION, .event_size = event_size };
+  SM_Recorder_write(self, &header, sizeof(header));
+}
+
+void SM_Recorder_attach(SM_Recorder* self){
+  SM_recorder = self;
+}
+
+void SM_Recorder_record(SM_Recorder* self, SM_RecordKind kind, SM_Context* context, int event_id, const void* event, const void* bytes, size_t length){
+  uint8_t record[14] = { (uint8_t)kind, event != NULL && self->event_size > 0 };
+  size_t used = 2;
+  memcpy(record + used, &context->id, sizeof(uint32_t));
+  used += sizeof(uint32_t);
+  if(kind == SM_RecordKind_NOTIFY_ID){
+    int32_t id = (int32_t)event_id;
+    memcpy(record + used, &id, sizeof(int32_t));
+    used += sizeof(int32_t);
+  }
+  if(kind == SM_RecordKind_FEED_BYTES){
+    SM_ASSERT(length <= UINT32_MAX && "too many bytes fed at once to record");
+    uint32_t length32 = (uint32_t)length;
+    memcpy(record + used, &length32, sizeof(uint32_t));
+    used += sizeof(uint32_t);
+  }
+  SM_Recorder_write(self, record, used);
+  if(record[1]) SM_Recorder_write(self, event, self->event_size);
+  if(length > 0) SM_Recorder_write(self, bytes, length);
+}
+
+#define SM_RECORD_CALL(kind, context, event_id, event, bytes, length) do{\
+    if(SM_recorder) SM_Recorder_record(SM_recorder, (kind), (context), (event_id), (event), (bytes), (length));\
+  }while(0)
+#else
+#define SM_RECORD_CALL(kind, context, event_id, event, bytes, length) do{}while(0)
+#endif
+
+// SM_step(), SM_notify() and SM_notify_id() without recording, for contexts that aren't the users own
+bool _SM_step(SM* self, SM_Context* context){
+  SM_ASSERT(self->initial_transition && "atleast one transition from SM_INITIAL_STATE must be created");
+  if(context->halted) return false;
+  if(self->compiled) return SM_step_compiled(self, context);
+  return SM_step_chain(self, context);
+}
+
+bool _SM_notify(SM* self, SM_Context* context, void* event){
+  if(context->halted) return false;
+  if(self->compiled) return SM_notify_compiled(self, context, event);
+  return SM_notify_chain(self, context, event);
+}
+
+bool _SM_notify_id(SM* self, SM_Context* context, int event_id, void* event){
+  if(context->halted) return false;
+  if(self->compiled) return SM_notify_id_compiled(self, context, event_id, event);
+  
+  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
+      transition != NULL; 
+      transition = SM_get_next_transition(self, context, transition))
+  {
+    SM_ASSERT(transition->source == context->current_state);
+    if( SM_Transition_is_event(transition) && transition->event == event_id &&
+        (!SM_Transition_has_guard(transition) || SM_Transition_check_guard(transition, context->user_context)) &&
+        (!SM_Transition_has_trigger(transition) || SM_Transition_check_trigger(transition, context->user_context, event)))
+    {
+      SM_transition(self, transition, context);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SM_step(SM* self, SM_Context* context){
+  SM_RECORD_CALL(SM_RecordKind_STEP, context, 0, NULL, NULL, 0);
+  return _SM_step(self, context);
+}
+
+bool SM_notify(SM* self, SM_Context* context, void* event){
+  SM_RECORD_CALL(SM_RecordKind_NOTIFY, context, 0, event, NULL, 0);
+  return _SM_notify(self, context, event);
+}
+
+bool SM_notify_id(SM* self, SM_Context* context, int event_id, void* event){
+  SM_RECORD_CALL(SM_RecordKind_NOTIFY_ID, context, event_id, event, NULL, 0);
+  return _SM_notify_id(self, context, event_id, event);
+}
+
+void SM_run(SM* self, SM_Context* context){
+  while(!context->halted){
+    SM_step(self, context);
+  };
+}
+
+#define SM_batch_context(contexts, stride, index) ((SM_Context*)((char*)(contexts) + (stride) * (index)))
+
+size_t SM_step_batch(SM* self, SM_Context* contexts, size_t count, size_t stride){
+  SM_ASSERT(self->initial_transition && "atleast one transition from SM_INITIAL_STATE must be created");
+  bool (*step)(SM*, SM_Context*) = self->compiled ? SM_step_compiled : SM_step_chain;
+  size_t stepped = 0;
+  for(size_t i = 0; i < count; ++i){
+    if(i + SM_PREFETCH_DISTANCE < count) SM_PREFETCH(SM_batch_context(contexts, stride, i + SM_PREFETCH_DISTANCE));
+    SM_Context* context = SM_batch_context(contexts, stride, i);
+    if(context->halted) continue;
+    step(self, context);
+    stepped++;
+  }
+  return stepped;
+}
+
+size_t SM_step_sync(SM* self, SM_Context* contexts, size_t count, size_t stride, SM_Transition** next){
+  SM_ASSERT(self->initial_transition && "atleast one transition from SM_INITIAL_STATE must be created");
+  SM_Transition* (*select)(SM*, SM_Context*) = self->compiled ? SM_select_compiled : SM_select_chain;
+
+  // evaluate guards against the current generation
+  for(size_t i = 0; i < count; ++i){
+    if(i + SM_PREFETCH_DISTANCE < count) SM_PREFETCH(SM_batch_context(contexts, stride, i + SM_PREFETCH_DISTANCE));
+    SM_Context* context = SM_batch_context(contexts, stride, i);
+    next[i] = context->halted ? NULL : select(self, context);
+  }
+
+  // commit the next generation
+  size_t stepped = 0;
+  for(size_t i = 0; i < count; ++i){
+    if(i + SM_PREFETCH_DISTANCE < count) SM_PREFETCH(SM_batch_context(contexts, stride, i + SM_PREFETCH_DISTANCE));
+    SM_Context* context = SM_batch_context(contexts, stride, i);
+    if(context->halted) continue;
+    SM_step_selected(self, context, next[i]);
+    stepped++;
+  }
+  return stepped;
+}
+
+size_t SM_notify_batch(SM* self, SM_Context* contexts, size_t count, size_t stride, void* event){
+  bool (*notify)(SM*, SM_Context*, void*) = self->compiled ? SM_notify_compiled : SM_notify_chain;
+  size_t handled = 0;
+  for(size_t i = 0; i < count; ++i){
+    if(i + SM_PREFETCH_DISTANCE < count) SM_PREFETCH(SM_batch_context(contexts, stride, i + SM_PREFETCH_DISTANCE));
+    SM_Context* context = SM_batch_context(contexts, stride, i);
+    if(context->halted) continue;
+    if(notify(self, context, event)) handled++;
+  }
+  return handled;
+}
+
+size_t SM_dispatch(SM* self, SM_Context* context, size_t max){
+  SM_ASSERT(context->queue && "no queue set for context, see SM_Context_set_queue()");
+  size_t count = 0;
+  void* event = NULL;
+  while(count < max && SM_Queue_pop(context->queue, &event)){
+    SM_notify(self, context, event);
+    count++;
+  }
+  return count;
+}
+
+// length of the run of bytes the self loop of the table is taken on, the first byte is already known to be part of it
+size_t SM_TransitionTable_get_byte_run(SM_TransitionTable* self, const uint8_t* data, size_t length){
+  size_t run = 1;
+#if defined(SM_AVX2) || defined(SM_SSE2)
+  // a byte is in range if subtracting the first byte of the range wraps it to at most the width of the range
+  size_t range_count = self->byte_run_range_count;
+  if(range_count > 0){
+#ifdef SM_AVX2
+    __m256i first_256[SM_BYTE_RUN_RANGES], width_256[SM_BYTE_RUN_RANGES];
+    for(size_t r = 0; r < range_count; ++r){
+      first_256[r] = _mm256_set1_epi8((char)self->byte_run_ranges[r][0]);
+      width_256[r] = _mm256_set1_epi8((char)(self->byte_run_ranges[r][1] - self->byte_run_ranges[r][0]));
+    }
+    while(run + 32 <= length){
+      __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + run));
+      __m256i match = _mm256_setzero_si256();
+      for(size_t r = 0; r < range_count; ++r){
+        __m256i excess = _mm256_subs_epu8(_mm256_sub_epi8(chunk, first_256[r]), width_256[r]);
+        match = _mm256_or_si256(match, _mm256_cmpeq_epi8(excess, _mm256_setzero_si256()));
+      }
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+      if(mask != 0xFFFFFFFFu) return run + (size_t)__builtin_ctz(~mask);
+      run += 32;
+    }
+#endif
+#ifdef SM_SSE2
+    __m128i first[SM_BYTE_RUN_RANGES], width[SM_BYTE_RUN_RANGES];
+    for(size_t r = 0; r < range_count; ++r){
+      first[r] = _mm_set1_epi8((char)self->byte_run_ranges[r][0]);
+      width[r] = _mm_set1_epi8((char)(self->byte_run_ranges[r][1] - self->byte_run_ranges[r][0]));
+    }
+    while(run + 16 <= length){
+      __m128i chunk = _mm_loadu_si128((const __m128i*)(data + run));
+      __m128i match = _mm_setzero_si128();
+      for(size_t r = 0; r < range_count; ++r){
+        __m128i excess = _mm_subs_epu8(_mm_sub_epi8(chunk, first[r]), width[r]);
+        match = _mm_or_si128(match, _mm_cmpeq_epi8(excess, _mm_setzero_si128()));
+      }
+      uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+      if(mask != 0xFFFFu) return run + (size_t)__builtin_ctz(~mask);
+      run += 16;
+    }
+#endif
+  }
+#endif
+  while(run < length && self->byte_table[data[run]] == self->byte_run) run++;
+  return run;
+}
+
+size_t SM_feed_bytes(SM* self, SM_Context* context, const void* bytes, size_t length){
+  SM_ASSERT(self->compiled && "byte transitions require SM_compile()");
+  SM_RECORD_CALL(SM_RecordKind_FEED_BYTES, context, 0, NULL, bytes, length);
+  const uint8_t* data = bytes;
+  size_t consumed = 0;
+  while(consumed < length && !context->halted){
+    SM_TransitionTable* table = SM_get_transition_table(self, context);
+    if(table->byte_table == NULL) break;
+    uint8_t index = table->byte_table[data[consumed]];
+    if(index == 0) break;
+    size_t run = 1;
+    if(index == table->byte_run) run = SM_TransitionTable_get_byte_run(table, &data[consumed], length - consumed);
+    SM_transition_bytes(self, SM_TransitionTable_get_bytes(table)[index - 1], context, &data[consumed], run);
+    consumed += run;
+  }
+  return consumed;
+}
+
+#ifdef SM_RECORD
+size_t SM_replay(SM* self, SM_Context* contexts, size_t count, const void* log, size_t size){
+  const uint8_t* data = log;
+  SM_RecordHeader header;
+  if(size < sizeof(header)) return 0;
+  memcpy(&header, data, sizeof(header));
+  if(header.magic != SM_RECORD_MAGIC || header.version != SM_RECORD_VERSION || header.event_size > SM_RECORD_MAX_EVENT_SIZE) return 0;
+
+  SM_Recorder* recorder = SM_recorder;
+  SM_recorder = NULL;
+  // events are copied out of the log so they are aligned like any struct
+  SM_CompileMemory event[(SM_RECORD_MAX_EVENT_SIZE + sizeof(SM_CompileMemory) - 1) / sizeof(SM_CompileMemory) + 1];
+  size_t position = sizeof(header);
+  size_t replayed = 0;
+  while(position + 6 <= size){
+    uint8_t kind = data[position];
+    bool has_event = data[position + 1];
+    uint32_t context_id;
+    memcpy(&context_id, data + position + 2, sizeof(uint32_t));
+    size_t next = position + 6;
+    int32_t event_id = 0;
+    uint32_t length = 0;
+    if(kind == SM_RecordKind_NOTIFY_ID){
+      if(next + sizeof(int32_t) > size) break;
+      memcpy(&event_id, data + next, sizeof(int32_t));
+      next += sizeof(int32_t);
+    }
+    if(kind == SM_RecordKind_FEED_BYTES){
+      if(next + sizeof(uint32_t) > size) break;
+      memcpy(&length, data + next, sizeof(uint32_t));
+      next += sizeof(uint32_t);
+    }
+    if(has_event){
+      if(next + header.event_size > size) break;
+      memcpy(event, data + next, (size_t)header.event_size);
+      next += (size_t)header.event_size;
+    }
+    if(next + length > size || kind > SM_RecordKind_FEED_BYTES) break;
+
+    if(context_id < count){
+      SM_Context* context = &contexts[context_id];
+      void* event_pointer = has_event ? (void*)event : NULL;
+      switch((SM_RecordKind)kind){
+        case SM_RecordKind_STEP: SM_step(self, context); break;
+        case SM_RecordKind_NOTIFY: SM_notify(self, context, event_pointer); break;
+        case SM_RecordKind_NOTIFY_ID: SM_notify_id(self, context, event_id, event_pointer); break;
+        case SM_RecordKind_FEED_BYTES: SM_feed_bytes(self, context, data + next, length); break;
+      }
+    }
+    position = next + length;
+    replayed++;
+  }
+  SM_recorder = recorder;
+  return replayed;
+}
+#endif
+
+#ifdef SM_STATS
+void SM_stats_snapshot(SM* self, SM_StateStats* states, uint64_t* fire_counts){
+  SM_ASSERT(self->compiled && "stats require SM_compile()");
+  for(size_t id = 0; states && id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    states[id] = (SM_StateStats){0};
+    if(state == SM_INITIAL_STATE) continue;
+    states[id].enter_count = SM_ATOMIC_LOAD_RELAXED(&state->stats.enter_count);
+    for(size_t i = 0; i < SM_STATS_BUCKETS; ++i){
+      states[id].dwell[i] = SM_ATOMIC_LOAD_RELAXED(&state->stats.dwell[i]);
+    }
+  }
+  for(size_t id = 0; fire_counts && id < self->unique_transition_count; ++id){
+    SM_Transition* transition = self->unique_transitions[id];
+    fire_counts[id] = transition ? SM_ATOMIC_LOAD_RELAXED(&transition->fire_count) : 0;
+  }
+}
+
+void SM_stats_clear(SM* self){
+  SM_ASSERT(self->compiled && "stats require SM_compile()");
+  for(size_t id = 1; id < self->state_count; ++id){
+    self->states[id]->stats = (SM_StateStats){0};
+  }
+  for(size_t id = 1; id < self->unique_transition_count; ++id){
+    self->unique_transitions[id]->fire_count = 0;
+  }
+}
+#endif
+
+#ifdef SM_PROFILE
+SM_ProfileSummary SM_Profile_summarize(SM_Profile* self){
+  SM_ProfileSummary summary = { .count = SM_ATOMIC_LOAD_RELAXED(&self->count) };
+  if(summary.count == 0) return summary;
+  summary.min = ~SM_ATOMIC_LOAD_RELAXED(&self->min_inverted);
+  summary.mean = (double)SM_ATOMIC_LOAD_RELAXED(&self->total) / (double)summary.count;
+  uint64_t rank = summary.count - summary.count / 100; // amount of calls atleast as fast as the 99th percentile
+  uint64_t seen = 0;
+  for(size_t i = 0; i < SM_PROFILE_BUCKETS; ++i){
+    seen += SM_ATOMIC_LOAD_RELAXED(&self->buckets[i]);
+    summary.p99 = i + 1 < 64 ? ((uint64_t)1 << (i + 1)) - 1 : UINT64_MAX;
+    if(seen >= rank) break;
+  }
+  if(seen < rank) summary.p99 = UINT64_MAX; // counts were updated while summarizing
+  return summary;
+}
+
+void SM_profile_report_line(FILE* out, const char* kind, const char* name, SM_Profile* profile){
+  SM_ProfileSummary summary = SM_Profile_summarize(profile);
+  if(summary.count == 0) return;
+  fprintf(out, "%s %s: count %llu, min %llu, mean %.1f, p99 %llu\n", kind, name ? name : "unnamed",
+      (unsigned long long)summary.count, (unsigned long long)summary.min, summary.mean, (unsigned long long)summary.p99);
+}
+
+void SM_profile_report(SM* self, FILE* out){
+  SM_ASSERT(self->compiled && "profile reports require SM_compile()");
+  for(size_t id = 1; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    SM_profile_report_line(out, "enter", state->trace_name, &state->enter_profile);
+    SM_profile_report_line(out, "do", state->trace_name, &state->do_profile);
+    SM_profile_report_line(out, "exit", state->trace_name, &state->exit_profile);
+  }
+  for(size_t id = 1; id < self->unique_transition_count; ++id){
+    SM_Transition* transition = self->unique_transitions[id];
+    SM_profile_report_line(out, "trigger", transition->trace_name, &transition->trigger_profile);
+    SM_profile_report_line(out, "guard", transition->trace_name, &transition->guard_profile);
+    SM_profile_report_line(out, "effect", transition->trace_name, &transition->effect_profile);
+  }
+}
+#endif
+
+// contexts unpacked from pools and regions have no timer, so their timeouts would never fire
+bool SM_has_timeouts(SM* self){
+  if(!self->compiled) return false; // timeouts are only armed for compiled state machines
+  for(size_t id = 1; id < self->unique_transition_count; ++id){
+    if(SM_Transition_has_timeout(self->unique_transitions[id])) return true;
+  }
+  return false;
+}
+
+void SM_ContextPool_init(SM_ContextPool* self, SM* sm, uint16_t* states, uint64_t* halted, void** user_contexts, size_t count){
+  SM_ASSERT(sm->compiled && "context pools require a compiled state machine, see SM_compile()");
+  SM_ASSERT(!SM_has_timeouts(sm) && "context pools don't support timeout transitions");
+  self->sm = sm;
+  self->states = states;
+  self->halted = halted;
+  self->user_contexts = user_contexts;
+  self->count = count;
+#ifdef SM_MMAP
+  self->mapping = NULL;
+  self->mapping_size = 0;
+#endif
+  self->active = NULL;
+#ifdef SM_DIRTY
+  self->dirty = NULL;
+#endif
+  for(size_t i = 0; i < count; ++i){
+    states[i] = 0;
+  }
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(count); ++i){
+    halted[i] = 0;
+  }
+}
+
+SM_State* SM_ContextPool_get_state(SM_ContextPool* self, size_t index){
+  return self->sm->states[self->states[index]];
+}
+
+bool SM_ContextPool_is_halted(SM_ContextPool* self, size_t index){
+  return (self->halted[index / 64] >> (index % 64)) & 1;
 }
 
-bool SM_Transition_check_trigger(SM_Transition* self, void* user_context, void* event){
-  if(self->trigger) 
-    return self->trigger(user_context, event);
-  return false;
+void SM_ContextPool_reset(SM_ContextPool* self, size_t index){
+  self->states[index] = 0;
+  self->halted[index / 64] &= ~((uint64_t)1 << (index % 64));
+  if(self->active) SM_ContextPool_wake(self, index);
+#ifdef SM_DIRTY
+  if(self->dirty) SM_ContextPool_invalidate(self, index);
+#endif
 }
 
-void SM_Transition_apply_effect(SM_Transition* self, void* user_context){
-  if(self->effect) self->effect(user_context);
+// index of the lowest set bit, word must not be 0
+size_t SM_lowest_bit(uint64_t word){
+#if defined(__GNUC__) || defined(__clang__)
+  return (size_t)__builtin_ctzll(word);
+#else
+  size_t bit = 0;
+  while(!((word >> bit) & 1)) bit++;
+  return bit;
+#endif
 }
 
-void SM_Transition_add_to_chain(SM_Transition* current, SM_Transition* new_transition){
-  while(current->next_transition != NULL){
-    current = current->next_transition;
+// the core functions operate on SM_Context so a pool entry is unpacked into one and packed back afterwards
+void SM_ContextPool_load(SM_ContextPool* self, size_t index, SM_Context* context){
+  SM_Context_init(context, self->user_contexts ? self->user_contexts[index] : NULL);
+  context->current_state = self->sm->states[self->states[index]];
+#if defined(SM_TRACE_BINARY) || defined(SM_RECORD)
+  context->id = (uint32_t)index;
+#endif
+#ifdef SM_DIRTY
+  if(self->dirty) context->dirty = (self->dirty[index / 64] >> (index % 64)) & 1;
+#endif
+}
+
+// the halted flag is set first so a pool file of a crashed process never has a final context that isn't halted
+void SM_ContextPool_store(SM_ContextPool* self, size_t index, SM_Context* context){
+  if(context->halted) self->halted[index / 64] |= (uint64_t)1 << (index % 64);
+  self->states[index] = context->current_state ? context->current_state->id : 0;
+#ifdef SM_DIRTY
+  if(self->dirty){
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    self->dirty[index / 64] = context->dirty ? self->dirty[index / 64] | bit : self->dirty[index / 64] & ~bit;
   }
-  current->next_transition = new_transition;
+#endif
 }
 
-void SM_State_add_transition(SM_State* self, SM_Transition* new_transition){
-  if(self->transition == NULL){
-    self->transition = new_transition;
-  }else{
-    SM_Transition_add_to_chain(self->transition, new_transition);
+bool SM_ContextPool_step(SM_ContextPool* self, size_t index){
+  if(SM_ContextPool_is_halted(self, index)) return false;
+  SM_Context context;
+  SM_ContextPool_load(self, index, &context);
+  SM_Transition* transition = SM_select_compiled(self->sm, &context);
+  // a step that changed nothing will change nothing the next time either, until something wakes the context
+  bool idle = !transition && !(context.current_state && context.current_state->do_action);
+  SM_step_selected(self->sm, &context, transition);
+  SM_ContextPool_store(self, index, &context);
+  if(self->active){
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    self->active[index / 64] = idle ? self->active[index / 64] & ~bit : self->active[index / 64] | bit;
   }
+  return true;
 }
 
-void SM_Context_init(SM_Context* self, void* user_context){
-  self->user_context = user_context;
-  self->current_state = SM_INITIAL_STATE;
-  self->halted = false;
+bool SM_ContextPool_notify(SM_ContextPool* self, size_t index, void* event){
+  if(SM_ContextPool_is_halted(self, index)) return false;
+  SM_Context context;
+  SM_ContextPool_load(self, index, &context);
+  bool handled = SM_notify_compiled(self->sm, &context, event);
+  SM_ContextPool_store(self, index, &context);
+  // triggers may change what the guards read even if the event isn't handled
+  if(self->active) SM_ContextPool_wake(self, index);
+#ifdef SM_DIRTY
+  if(self->dirty) SM_ContextPool_invalidate(self, index);
+#endif
+  return handled;
 }
 
-void SM_Context_reset(SM_Context* self){
-  self->current_state = SM_INITIAL_STATE;
-  self->halted = false;
+size_t SM_ContextPool_step_all(SM_ContextPool* self){
+  size_t stepped = 0;
+  for(size_t i = 0; i < self->count; ++i){
+    // skip whole words of halted contexts at once
+    if(i % 64 == 0 && self->halted[i / 64] == UINT64_MAX && i + 64 <= self->count){
+      i += 63;
+      continue;
+    }
+    if(SM_ContextPool_step(self, i)) stepped++;
+  }
+  return stepped;
 }
 
-bool SM_Context_is_halted(SM_Context* self){
-  return self->halted;
+size_t SM_ContextPool_notify_all(SM_ContextPool* self, void* event){
+  size_t handled = 0;
+  for(size_t i = 0; i < self->count; ++i){
+    if(i % 64 == 0 && self->halted[i / 64] == UINT64_MAX && i + 64 <= self->count){
+      i += 63;
+      continue;
+    }
+    if(SM_ContextPool_notify(self, i, event)) handled++;
+  }
+  return handled;
 }
 
-void _SM_init(SM* self){
-  self->init = true;
+void SM_ContextPool_set_active(SM_ContextPool* self, uint64_t* active){
+  self->active = active;
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(self->count); ++i){
+    active[i] = UINT64_MAX;
+  }
 }
 
-void SM_transition(SM* self, SM_Transition* transition, SM_Context* context){
+void SM_ContextPool_wake(SM_ContextPool* self, size_t index){
+  SM_ASSERT(self->active && "no active bitset set for pool, see SM_ContextPool_set_active()");
+  self->active[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+bool SM_ContextPool_is_parked(SM_ContextPool* self, size_t index){
+  return self->active && !((self->active[index / 64] >> (index % 64)) & 1);
+}
+
+size_t SM_ContextPool_step_active(SM_ContextPool* self){
+  SM_ASSERT(self->active && "no active bitset set for pool, see SM_ContextPool_set_active()");
+  size_t stepped = 0;
+  for(size_t word = 0; word < SM_CONTEXT_POOL_WORDS(self->count); ++word){
+    uint64_t pending = self->active[word] & ~self->halted[word];
+    while(pending){
+      size_t index = word * 64 + SM_lowest_bit(pending);
+      pending &= pending - 1;
+      if(index >= self->count) break;
+      SM_ContextPool_step(self, index);
+      stepped++;
+    }
+  }
+  return stepped;
+}
+
+#ifdef SM_DIRTY
+void SM_ContextPool_set_dirty(SM_ContextPool* self, uint64_t* dirty){
+  self->dirty = dirty;
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(self->count); ++i){
+    dirty[i] = UINT64_MAX;
+  }
+}
+
+void SM_ContextPool_invalidate(SM_ContextPool* self, size_t index){
+  SM_ASSERT(self->dirty && "no dirty bitset set for pool, see SM_ContextPool_set_dirty()");
+  self->dirty[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+size_t SM_ContextPool_step_dirty(SM_ContextPool* self){
+  SM_ASSERT(self->dirty && "no dirty bitset set for pool, see SM_ContextPool_set_dirty()");
+  size_t stepped = 0;
+  for(size_t word = 0; word < SM_CONTEXT_POOL_WORDS(self->count); ++word){
+    uint64_t pending = self->dirty[word] & ~self->halted[word];
+    while(pending){
+      size_t index = word * 64 + SM_lowest_bit(pending);
+      pending &= pending - 1;
+      if(index >= self->count) break;
+      SM_ContextPool_step(self, index);
+      stepped++;
+    }
+  }
+  return stepped;
+}
+#endif
+
+uint64_t SM_fingerprint_bytes(uint64_t hash, const void* bytes, size_t length){
+  const uint8_t* data = bytes;
+  for(size_t i = 0; i < length; ++i){
+    hash ^= data[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint64_t SM_fingerprint_value(uint64_t hash, uint64_t value){
+  for(size_t i = 0; i < 8; ++i){
+    hash ^= (value >> (8 * i)) & 0xff;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint64_t SM_fingerprint_name(uint64_t hash, const char* name){
+  if(name) hash = SM_fingerprint_bytes(hash, name, strlen(name));
+  return SM_fingerprint_value(hash, 0);
+}
+
+uint64_t SM_fingerprint(SM* self){
+  SM_ASSERT(self->compiled && "fingerprints require SM_compile()");
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = SM_fingerprint_value(hash, self->state_count);
+  hash = SM_fingerprint_value(hash, self->unique_transition_count);
+  for(size_t id = 1; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    hash = SM_fingerprint_value(hash, state->parent ? ((SM_State*)state->parent)->id : 0);
+    hash = SM_fingerprint_name(hash, state->trace_name);
+  }
+  for(size_t id = 1; id < self->unique_transition_count; ++id){
+    SM_Transition* transition = self->unique_transitions[id];
+    hash = SM_fingerprint_value(hash, transition->source ? transition->source->id : 0);
+    hash = SM_fingerprint_value(hash, transition->target ? transition->target->id : 0);
+    hash = SM_fingerprint_value(hash, transition->has_event ? (uint64_t)(uint32_t)transition->event : UINT64_MAX);
+    hash = SM_fingerprint_value(hash, transition->has_timeout ? transition->timeout : UINT64_MAX);
+    hash = SM_fingerprint_name(hash, transition->trace_name);
+  }
+  return hash;
+}
+
+// only states that can be current have a transition table, parents that are never entered directly don't
+bool SM_is_valid_state_id(SM* self, uint64_t id){
+  return id == 0 || (id < self->state_count && self->states[id]->table.transitions != NULL);
+}
+
+size_t SM_Context_serialize(SM* self, SM_Context* context, void* buffer, size_t size){
+  SM_ASSERT(self->compiled && "serializing contexts requires SM_compile()");
+  SM_ASSERT(size >= SM_CONTEXT_SERIALIZED_SIZE && "buffer too small");
   (void)(self);
-#ifdef SM_TRACE
-  SM_TRACE_LOG_FMT("transition triggered: '%s' -> '%s'\n", 
-      SM_State_get_trace_name(transition->source),
-      SM_State_get_trace_name(transition->target));
+  (void)(size);
+  uint8_t* data = buffer;
+  uint16_t id = context->current_state ? context->current_state->id : 0;
+  data[0] = (uint8_t)(id & 0xff);
+  data[1] = (uint8_t)(id >> 8);
+  data[2] = context->halted ? 1 : 0;
+  return SM_CONTEXT_SERIALIZED_SIZE;
+}
+
+bool SM_Context_deserialize(SM* self, SM_Context* context, const void* buffer, size_t size){
+  SM_ASSERT(self->compiled && "deserializing contexts requires SM_compile()");
+  const uint8_t* data = buffer;
+  if(size < SM_CONTEXT_SERIALIZED_SIZE || data[2] > 1) return false;
+  uint16_t id = (uint16_t)(data[0] | (data[1] << 8));
+  if(!SM_is_valid_state_id(self, id)) return false;
+  context->current_state = self->states[id];
+  context->halted = data[2] == 1;
+  if(context->timer) SM_Timer_reset(context->timer, self, context, 0);
+  return true;
+}
+
+size_t SM_ContextPool_file_size(size_t count){
+  return sizeof(SM_PoolFileHeader) + SM_CONTEXT_POOL_WORDS(count) * sizeof(uint64_t) + count * sizeof(uint16_t);
+}
+
+size_t SM_ContextPool_save_file(SM_ContextPool* self, void* memory, size_t size){
+  size_t file_size = SM_ContextPool_file_size(self->count);
+  SM_ASSERT(size >= file_size && "memory too small for the pool file, see SM_ContextPool_file_size()");
+  SM_ASSERT((uintptr_t)memory % sizeof(uint64_t) == 0 && "pool file memory must be aligned to 8 bytes");
+  (void)(size);
+  SM_PoolFileHeader* header = memory;
+  *header = (SM_PoolFileHeader){
+    .magic = SM_POOL_FILE_MAGIC,
+    .version = SM_POOL_FILE_VERSION,
+    .fingerprint = SM_fingerprint(self->sm),
+    .count = self->count,
+  };
+  uint64_t* halted = (uint64_t*)(header + 1);
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(self->count); ++i){
+    halted[i] = self->halted[i];
+  }
+  uint16_t* states = (uint16_t*)(halted + SM_CONTEXT_POOL_WORDS(self->count));
+  for(size_t i = 0; i < self->count; ++i){
+    states[i] = self->states[i];
+  }
+  return file_size;
+}
+
+bool SM_pool_file_is_valid(SM* sm, const void* memory, size_t size, size_t count){
+  SM_ASSERT((uintptr_t)memory % sizeof(uint64_t) == 0 && "pool file memory must be aligned to 8 bytes");
+  const SM_PoolFileHeader* header = memory;
+  if(size < sizeof(SM_PoolFileHeader) || header->magic != SM_POOL_FILE_MAGIC || header->version != SM_POOL_FILE_VERSION) return false;
+  if(header->count != count || size < SM_ContextPool_file_size(count)) return false;
+  if(header->fingerprint != SM_fingerprint(sm)) return false;
+  const uint16_t* states = (const uint16_t*)((const uint64_t*)(header + 1) + SM_CONTEXT_POOL_WORDS(count));
+  for(size_t i = 0; i < count; ++i){
+    if(!SM_is_valid_state_id(sm, states[i])) return false;
+  }
+  return true;
+}
+
+// restored contexts are runnable and have to check their guards, whatever they were before
+void SM_ContextPool_mark_restored(SM_ContextPool* self){
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(self->count); ++i){
+    if(self->active) self->active[i] = UINT64_MAX;
+#ifdef SM_DIRTY
+    if(self->dirty) self->dirty[i] = UINT64_MAX;
 #endif
-  SM_State_exit(context->current_state, context->user_context);
-  SM_Transition_apply_effect(transition, context->user_context);
-  SM_State_enter(transition->target, context->user_context);
-  context->current_state = transition->target;
-  if(context->current_state == SM_FINAL_STATE){
-    context->halted = true;
   }
 }
 
-void SM_add_transition(SM* self, SM_Transition* transition){
-  if(transition->source != SM_INITIAL_STATE){
-    SM_State_add_transition(transition->source, transition);
-  }else{
-    if(self->initial_transition == NULL){
-      self->initial_transition = transition;
-    }else{
-      SM_Transition_add_to_chain(self->initial_transition, transition);
-    }
+bool SM_ContextPool_load_file(SM_ContextPool* self, const void* memory, size_t size){
+  if(!SM_pool_file_is_valid(self->sm, memory, size, self->count)) return false;
+  const uint64_t* halted = (const uint64_t*)((const SM_PoolFileHeader*)memory + 1);
+  const uint16_t* states = (const uint16_t*)(halted + SM_CONTEXT_POOL_WORDS(self->count));
+  for(size_t i = 0; i < self->count; ++i){
+    self->states[i] = states[i];
   }
+  for(size_t i = 0; i < SM_CONTEXT_POOL_WORDS(self->count); ++i){
+    self->halted[i] = halted[i];
+  }
+  SM_ContextPool_mark_restored(self);
+  return true;
 }
 
+bool SM_ContextPool_init_file(SM_ContextPool* self, SM* sm, void* memory, size_t size, void** user_contexts, size_t count){
+  SM_ASSERT(sm->compiled && "context pools require a compiled state machine, see SM_compile()");
+  SM_ASSERT(!SM_has_timeouts(sm) && "context pools don't support timeout transitions");
+  SM_ASSERT((uintptr_t)memory % sizeof(uint64_t) == 0 && "pool file memory must be aligned to 8 bytes");
+  if(size < SM_ContextPool_file_size(count)) return false;
+  SM_PoolFileHeader* header = memory;
+  uint64_t* halted = (uint64_t*)(header + 1);
+  uint16_t* states = (uint16_t*)(halted + SM_CONTEXT_POOL_WORDS(count));
+  if(header->magic == 0){
+    // the header is written last so a crash while creating the file leaves it zeroed
+    SM_ContextPool_init(self, sm, states, halted, user_contexts, count);
+    SM_PoolFileHeader created = { .magic = SM_POOL_FILE_MAGIC, .version = SM_POOL_FILE_VERSION, .fingerprint = SM_fingerprint(sm), .count = count };
+    *header = created;
+    return true;
+  }
+  if(!SM_pool_file_is_valid(sm, memory, size, count)) return false;
+  *self = (SM_ContextPool){ .sm = sm, .states = states, .halted = halted, .user_contexts = user_contexts, .count = count };
+  SM_ContextPool_mark_restored(self);
+  return true;
+}
 
-SM_Transition* SM_get_next_transition(SM* self, SM_Context* context, SM_Transition* transition){
-  if(transition == NULL){
-    if(context->current_state == SM_INITIAL_STATE){
-      return self->initial_transition;
-    }else{
-      return (SM_Transition*) context->current_state->transition;
+#ifdef SM_MMAP
+bool SM_ContextPool_open(SM_ContextPool* self, SM* sm, const char* path, void** user_contexts, size_t count){
+  size_t size = SM_ContextPool_file_size(count);
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if(fd < 0) return false;
+  // new files are zero filled by ftruncate(), files of another size are never resized
+  struct stat status;
+  bool ok = fstat(fd, &status) == 0 && 
+    ((status.st_size == 0 && ftruncate(fd, (off_t)size) == 0) || (size_t)status.st_size == size);
+  void* mapping = ok ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if(mapping == MAP_FAILED) return false;
+  if(!SM_ContextPool_init_file(self, sm, mapping, size, user_contexts, count)){
+    munmap(mapping, size);
+    return false;
+  }
+  self->mapping = mapping;
+  self->mapping_size = size;
+  return true;
+}
+
+bool SM_ContextPool_sync(SM_ContextPool* self){
+  SM_ASSERT(self->mapping && "pool wasn't opened by SM_ContextPool_open()");
+  return msync(self->mapping, self->mapping_size, MS_SYNC) == 0;
+}
+
+void SM_ContextPool_close(SM_ContextPool* self){
+  SM_ASSERT(self->mapping && "pool wasn't opened by SM_ContextPool_open()");
+  munmap(self->mapping, self->mapping_size);
+  self->mapping = NULL;
+  self->mapping_size = 0;
+}
+#endif
+
+void SM_RegionContext_init(SM_RegionContext* self, SM** regions, SM_State** current_states, size_t region_count, void* user_context){
+  SM_ASSERT(region_count <= SM_MAX_REGIONS && "too many regions");
+  for(size_t i = 0; i < region_count; ++i){
+    SM_ASSERT(!SM_has_timeouts(regions[i]) && "regions don't support timeout transitions");
+  }
+  self->user_context = user_context;
+  self->regions = regions;
+  self->current_states = current_states;
+  self->region_count = region_count;
+  self->halted = 0;
+  for(size_t i = 0; i < region_count; ++i){
+    current_states[i] = SM_INITIAL_STATE;
+  }
+}
+
+bool SM_RegionContext_is_halted(SM_RegionContext* self){
+  return self->region_count == SM_MAX_REGIONS ? self->halted == UINT64_MAX :
+    self->halted == ((uint64_t)1 << self->region_count) - 1;
+}
+
+// like pool entries, each region is unpacked into a SM_Context for the core functions
+void SM_RegionContext_load(SM_RegionContext* self, size_t region, SM_Context* context){
+  SM_Context_init(context, self->user_context);
+  context->current_state = self->current_states[region];
+}
+
+void SM_RegionContext_store(SM_RegionContext* self, size_t region, SM_Context* context){
+  self->current_states[region] = context->current_state;
+  if(context->halted) self->halted |= (uint64_t)1 << region;
+}
+
+bool SM_RegionContext_step(SM_RegionContext* self){
+  bool stepped = false;
+  for(size_t i = 0; i < self->region_count; ++i){
+    if((self->halted >> i) & 1) continue;
+    SM_Context context;
+    SM_RegionContext_load(self, i, &context);
+    stepped |= _SM_step(self->regions[i], &context);
+    SM_RegionContext_store(self, i, &context);
+  }
+  return stepped;
+}
+
+bool SM_RegionContext_notify(SM_RegionContext* self, void* event){
+  bool handled = false;
+  for(size_t i = 0; i < self->region_count; ++i){
+    if((self->halted >> i) & 1) continue;
+    SM_Context context;
+    SM_RegionContext_load(self, i, &context);
+    handled |= _SM_notify(self->regions[i], &context, event);
+    SM_RegionContext_store(self, i, &context);
+  }
+  return handled;
+}
+
+bool SM_RegionContext_notify_id(SM_RegionContext* self, int event_id, void* event){
+  bool handled = false;
+  for(size_t i = 0; i < self->region_count; ++i){
+    if((self->halted >> i) & 1) continue;
+    SM_Context context;
+    SM_RegionContext_load(self, i, &context);
+    handled |= _SM_notify_id(self->regions[i], &context, event_id, event);
+    SM_RegionContext_store(self, i, &context);
+  }
+  return handled;
+}
+
+#ifdef SM_CODEGEN
+
+void SM_State_set_enter_action_named(SM_State* self, SM_ActionCallback action, const char* name){
+  SM_State_set_enter_action(self, action);
+  self->enter_action_name = name;
+}
+
+void SM_State_set_do_action_named(SM_State* self, SM_ActionCallback action, const char* name){
+  SM_State_set_do_action(self, action);
+  self->do_action_name = name;
+}
+
+void SM_State_set_exit_action_named(SM_State* self, SM_ActionCallback action, const char* name){
+  SM_State_set_exit_action(self, action);
+  self->exit_action_name = name;
+}
+
+void SM_Transition_set_trigger_named(SM_Transition* self, SM_TriggerCallback trigger, const char* name){
+  SM_Transition_set_trigger(self, trigger);
+  self->trigger_name = name;
+}
+
+void SM_Transition_set_guard_named(SM_Transition* self, SM_GuardCallback guard, const char* name){
+  SM_Transition_set_guard(self, guard);
+  self->guard_name = name;
+}
+
+void SM_Transition_set_effect_named(SM_Transition* self, SM_ActionCallback effect, const char* name){
+  SM_Transition_set_effect(self, effect);
+  self->effect_name = name;
+}
+
+bool SM_codegen_is_identifier(const char* name){
+  if(!((*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z') || *name == '_')) return false;
+  for(const char* ch = name + 1; *ch; ++ch){
+    if(!((*ch >= 'a' && *ch <= 'z') || (*ch >= 'A' && *ch <= 'Z') || (*ch >= '0' && *ch <= '9') || *ch == '_')) return false;
+  }
+  return true;
+}
+
+// open addressing set of the callback names declared so far
+typedef struct{
+  FILE* out;
+  const char* sm_name;
+  const char* names[2 * SM_CODEGEN_MAX_CALLBACKS];
+  size_t count;
+} SM_CodegenDeclarations;
+
+// declares a set callback the first time its name is seen, 
+// returns false and writes an #error if the callback can't be called by its name
+bool SM_codegen_declare(SM_CodegenDeclarations* self, bool set, const char* name, const char* owner, const char* prototype){
+  if(!set) return true;
+  if(name == NULL || !SM_codegen_is_identifier(name)){
+    fprintf(self->out, "#error \"state machine '%s': callback of '%s' is not named by a plain identifier, "
+        "define SM_CODEGEN before including sm.h and pass functions by name\"\n", self->sm_name, owner ? owner : "unnamed");
+    return false;
+  }
+  // once the set is full names are declared at every use, repeating a declaration is still valid C
+  if(self->count < SM_CODEGEN_MAX_CALLBACKS){
+    size_t mask = 2 * SM_CODEGEN_MAX_CALLBACKS - 1;
+    size_t slot = (size_t)SM_fingerprint_bytes(0xcbf29ce484222325ull, name, strlen(name)) & mask;
+    for(; self->names[slot] != NULL; slot = (slot + 1) & mask){
+      if(strcmp(self->names[slot], name) == 0) return true;
     }
+    self->names[slot] = name;
+    self->count++;
+  }
+  fprintf(self->out, prototype, name);
+  return true;
+}
+
+// writes the enum constant of the state, characters that can not be part of an identifier are replaced
+void SM_codegen_state(FILE* out, const char* name, SM_State* state){
+  if(state == SM_INITIAL_STATE){
+    fprintf(out, "%s_STATE_INITIAL", name);
+  }else if(state->trace_name == NULL){
+    fprintf(out, "%s_STATE_%u", name, (unsigned)state->id);
   }else{
-    return (SM_Transition*) transition->next_transition;
+    fprintf(out, "%s_STATE_", name);
+    for(const char* ch = state->trace_name; *ch; ++ch){
+      bool valid = (*ch >= 'a' && *ch <= 'z') || (*ch >= 'A' && *ch <= 'Z') || (*ch >= '0' && *ch <= '9');
+      fputc(valid ? *ch : '_', out);
+    }
   }
 }
 
-bool SM_step(SM* self, SM_Context* context){
-  SM_ASSERT(self->initial_transition && "atleast one transition from SM_INITIAL_STATE must be created");
-  if(context->halted) return false;
-  
-  // check all guards without triggers first
-  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
-      transition != NULL; 
-      transition = SM_get_next_transition(self, context, transition))
-  {
-    SM_ASSERT(transition->source == context->current_state && "transition not valid for current state");
-    if(!SM_Transition_has_trigger(transition) &&
-        SM_Transition_check_guard(transition, context->user_context))
+// unrolls SM_transition() for a transition taken while the given state is active
+void SM_codegen_transition(FILE* out, const char* name, SM_State* current, SM_Transition* transition, const char* indent){
+  fprintf(out, "%s// %s\n", indent, transition->trace_name ? transition->trace_name : "unnamed transition");
+  for(SM_State* state = current; state != transition->lca; state = state->parent){
+    if(state->exit_action) fprintf(out, "%s%s(user_context);\n", indent, state->exit_action_name);
+  }
+  if(transition->effect) fprintf(out, "%s%s(user_context);\n", indent, transition->effect_name);
+  for(size_t i = 0; i < transition->enter_count; ++i){
+    fprintf(out, "%s%s(user_context);\n", indent, transition->enter_path[i]->enter_action_name);
+  }
+  fprintf(out, "%sself->current_state = ", indent);
+  SM_codegen_state(out, name, transition->target);
+  fprintf(out, ";\n");
+  if(transition->target == SM_FINAL_STATE) fprintf(out, "%sself->halted = true;\n", indent);
+  fprintf(out, "%sreturn true;\n", indent);
+}
+
+// writes the condition under which a guarded, triggered or event transition fires
+void SM_codegen_condition(FILE* out, SM_Transition* transition){
+  const char* separator = "";
+  if(transition->has_event){
+    fprintf(out, "event_id == %d", transition->event);
+    separator = " && ";
+  }
+  if(transition->guard){
+    fprintf(out, "%s%s(user_context)", separator, transition->guard_name);
+    separator = " && ";
+  }
+  if(transition->trigger){
+    fprintf(out, "%s%s(user_context, event)", separator, transition->trigger_name);
+  }
+}
+
+SM_TransitionTable* SM_codegen_table(SM* self, size_t id){
+  return id == 0 ? &self->initial_table : &self->states[id]->table;
+}
+
+bool SM_codegen(SM* self, FILE* out, const char* name){
+  fprintf(out, "// generated by SM_codegen() for state machine '%s', do not edit\n\n", name);
+  fprintf(out, "#include <stdbool.h>\n\n");
+  if(!self->compiled){
+    fprintf(out, "#error \"state machine '%s' must be compiled using SM_compile() before generating code\"\n", name);
+    return false;
+  }
+
+  // declare every named callback once, the generated code calls them directly
+  SM_CodegenDeclarations declarations = { .out = out, .sm_name = name };
+  for(size_t id = 1; id < self->unique_transition_count; ++id){
+    SM_Transition* transition = self->unique_transitions[id];
+    if(transition->has_timeout || SM_Transition_has_byte_class(transition)){
+      fprintf(out, "#error \"state machine '%s': timeout or byte transition '%s' is not supported in generated code\"\n", 
+          name, transition->trace_name ? transition->trace_name : "unnamed");
+      return false;
+    }
+    if(!SM_codegen_declare(&declarations, transition->trigger != NULL, transition->trigger_name, transition->trace_name, 
+          "bool %s(void* user_context, void* event);\n") ||
+        !SM_codegen_declare(&declarations, transition->guard != NULL, transition->guard_name, transition->trace_name, 
+          "bool %s(void* user_context);\n") ||
+        !SM_codegen_declare(&declarations, transition->effect != NULL, transition->effect_name, transition->trace_name, 
+          "void %s(void* user_context);\n"))
     {
-      SM_transition(self, transition, context);
-      return true;
+      return false;
     }
   }
-
-  // check any transitions without triggers and guards
-  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
-      transition != NULL; 
-      transition = SM_get_next_transition(self, context, transition))
-  {
-    SM_ASSERT(transition->source == context->current_state && "transition not valid for current state");
-    if(!SM_Transition_has_trigger_or_guard(transition))
+  for(size_t id = 1; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    if(!SM_codegen_declare(&declarations, state->enter_action != NULL, state->enter_action_name, state->trace_name, 
+          "void %s(void* user_context);\n") ||
+        !SM_codegen_declare(&declarations, state->do_action != NULL, state->do_action_name, state->trace_name, 
+          "void %s(void* user_context);\n") ||
+        !SM_codegen_declare(&declarations, state->exit_action != NULL, state->exit_action_name, state->trace_name, 
+          "void %s(void* user_context);\n"))
     {
-      SM_transition(self, transition, context);
-      return true;
+      return false;
+    }
+  }
+
+  fprintf(out, "\ntypedef enum{\n");
+  for(size_t id = 0; id < self->state_count; ++id){
+    fprintf(out, "  ");
+    SM_codegen_state(out, name, self->states[id]);
+    fprintf(out, " = %u,\n", (unsigned)id);
+  }
+  fprintf(out, "} %s_State;\n\n", name);
+
+  fprintf(out, "typedef struct{\n  void* user_context;\n  %s_State current_state;\n  bool halted;\n} %s_Context;\n\n", name, name);
+
+  fprintf(out, "void %s_Context_init(%s_Context* self, void* user_context){\n", name, name);
+  fprintf(out, "  self->user_context = user_context;\n  self->current_state = %s_STATE_INITIAL;\n  self->halted = false;\n}\n\n", name);
+
+  // SM_step(): guarded transitions in order, then the first unconditional one or the do_action
+  fprintf(out, "bool %s_step(%s_Context* self){\n", name, name);
+  fprintf(out, "  void* user_context = self->user_context;\n  (void)(user_context);\n");
+  fprintf(out, "  if(self->halted) return false;\n  switch(self->current_state){\n");
+  for(size_t id = 0; id < self->state_count; ++id){
+    SM_State* state = self->states[id];
+    if(state != SM_INITIAL_STATE && state->table.transitions == NULL) continue; // parent that is never current
+    SM_TransitionTable* table = SM_codegen_table(self, id);
+    SM_Transition** transitions = (SM_Transition**) table->transitions;
+    fprintf(out, "    case ");
+    SM_codegen_state(out, name, state);
+    fprintf(out, ":\n");
+    for(size_t i = 0; i < table->guard_count; ++i){
+      fprintf(out, "      if(");
+      SM_codegen_condition(out, transitions[i]);
+      fprintf(out, "){\n");
+      SM_codegen_transition(out, name, state, transitions[i], "        ");
+      fprintf(out, "      }\n");
+    }
+    if(table->unconditional_count > 0){
+      SM_codegen_transition(out, name, state, transitions[table->guard_count], "      ");
+    }else{
+      if(state != SM_INITIAL_STATE && state->do_action) fprintf(out, "      %s(user_context);\n", state->do_action_name);
+      fprintf(out, "      return true;\n");
+    }
+  }
+  fprintf(out, "    default:\n      return true;\n  }\n}\n\n");
+
+  // SM_notify(): triggered transitions in order
+  fprintf(out, "bool %s_notify(%s_Context* self, void* event){\n", name, name);
+  fprintf(out, "  void* user_context = self->user_context;\n  (void)(user_context);\n  (void)(event);\n");
+  fprintf(out, "  if(self->halted) return false;\n  switch(self->current_state){\n");
+  for(size_t id = 0; id < self->state_count; ++id){
+    SM_TransitionTable* table = SM_codegen_table(self, id);
+    SM_Transition** transitions = (SM_Transition**) table->transitions + table->guard_count + table->unconditional_count;
+    if(table->trigger_count == 0) continue;
+    fprintf(out, "    case ");
+    SM_codegen_state(out, name, self->states[id]);
+    fprintf(out, ":\n");
+    for(size_t i = 0; i < table->trigger_count; ++i){
+      fprintf(out, "      if(");
+      SM_codegen_condition(out, transitions[i]);
+      fprintf(out, "){\n");
+      SM_codegen_transition(out, name, self->states[id], transitions[i], "        ");
+      fprintf(out, "      }\n");
+    }
+    fprintf(out, "      return false;\n");
+  }
+  fprintf(out, "    default:\n      return false;\n  }\n}\n\n");
+
+  // SM_notify_id(): event transitions ordered by id
+  fprintf(out, "bool %s_notify_id(%s_Context* self, int event_id, void* event){\n", name, name);
+  fprintf(out, "  void* user_context = self->user_context;\n  (void)(user_context);\n  (void)(event_id);\n  (void)(event);\n");
+  fprintf(out, "  if(self->halted) return false;\n  switch(self->current_state){\n");
+  for(size_t id = 0; id < self->state_count; ++id){
+    SM_TransitionTable* table = SM_codegen_table(self, id);
+    SM_Transition** transitions = (SM_Transition**) table->transitions + 
+      table->guard_count + table->unconditional_count + table->trigger_count;
+    if(table->event_count == 0) continue;
+    fprintf(out, "    case ");
+    SM_codegen_state(out, name, self->states[id]);
+    fprintf(out, ":\n");
+    for(size_t i = 0; i < table->event_count; ++i){
+      fprintf(out, "      if(");
+      SM_codegen_condition(out, transitions[i]);
+      fprintf(out, "){\n");
+      SM_codegen_transition(out, name, self->states[id], transitions[i], "        ");
+      fprintf(out, "      }\n");
     }
+    fprintf(out, "      return false;\n");
   }
+  fprintf(out, "    default:\n      return false;\n  }\n}\n\n");
 
-  SM_State_do(context->current_state, context->user_context);
+  fprintf(out, "void %s_run(%s_Context* self){\n  while(%s_step(self));\n}\n", name, name, name);
   return true;
 }
 
-bool SM_notify(SM* self, SM_Context* context, void* event){
-  if(context->halted) return false;
-  
-  for(SM_Transition* transition = SM_get_next_transition(self, context, NULL); 
-      transition != NULL; 
-      transition = SM_get_next_transition(self, context, transition))
-  {
-    SM_ASSERT(transition->source == context->current_state);
-    if( (!SM_Transition_has_guard(transition) || SM_Transition_check_guard(transition, context->user_context)) &&
-        SM_Transition_check_trigger(transition, context->user_context, event))
-    {
-      SM_transition(self, transition, context);
-      return true;
+#endif // SM_CODEGEN
+
+#ifdef SM_EXECUTOR
+
+// claims chunks from the worker's own range first and then steals from the other ranges
+void SM_Executor_work(SM_Executor* self, size_t worker){
+  size_t stepped = 0;
+  for(size_t i = 0; i < self->thread_count; ++i){
+    SM_ExecutorWorker* victim = &self->workers[(worker + i) % self->thread_count];
+    for(;;){
+      size_t begin = SM_ATOMIC_FETCH_ADD_RELAXED(&victim->next, SM_EXECUTOR_CHUNK_SIZE);
+      if(begin >= victim->end) break;
+      size_t count = victim->end - begin < SM_EXECUTOR_CHUNK_SIZE ? victim->end - begin : SM_EXECUTOR_CHUNK_SIZE;
+      stepped += SM_step_batch(self->sm, SM_batch_context(self->contexts, self->stride, begin), count, self->stride);
     }
   }
-  return false;
+  SM_ATOMIC_FETCH_ADD_RELAXED(&self->stepped, stepped);
 }
 
-void SM_run(SM* self, SM_Context* context){
-  while(!context->halted){
-    SM_step(self, context);
-  };
+void* SM_Executor_thread(void* arg){
+  SM_Executor* self = ((SM_ExecutorWorker*)arg)->executor;
+  size_t worker = ((SM_ExecutorWorker*)arg)->index;
+  size_t generation = 0;
+  for(;;){
+    pthread_mutex_lock(&self->mutex);
+    while(self->generation == generation && !self->stop){
+      pthread_cond_wait(&self->start, &self->mutex);
+    }
+    if(self->stop){
+      pthread_mutex_unlock(&self->mutex);
+      return NULL;
+    }
+    generation = self->generation;
+    pthread_mutex_unlock(&self->mutex);
+
+    SM_Executor_work(self, worker);
+
+    pthread_mutex_lock(&self->mutex);
+    if(--self->busy == 0) pthread_cond_signal(&self->done);
+    pthread_mutex_unlock(&self->mutex);
+  }
+}
+
+void SM_Executor_init(SM_Executor* self, SM* sm, size_t thread_count){
+  SM_ASSERT(thread_count > 0 && thread_count <= SM_EXECUTOR_MAX_THREADS && "invalid executor thread count");
+  self->sm = sm;
+  self->thread_count = thread_count;
+  self->generation = 0;
+  self->busy = 0;
+  self->stop = false;
+  pthread_mutex_init(&self->mutex, NULL);
+  pthread_cond_init(&self->start, NULL);
+  pthread_cond_init(&self->done, NULL);
+  // worker 0 is the thread calling SM_Executor_step_all()
+  for(size_t i = 0; i < thread_count; ++i){
+    self->workers[i].executor = self;
+    self->workers[i].index = i;
+  }
+  for(size_t i = 1; i < thread_count; ++i){
+    pthread_create(&self->threads[i], NULL, SM_Executor_thread, &self->workers[i]);
+  }
+}
+
+size_t SM_Executor_step_all(SM_Executor* self, SM_Context* contexts, size_t count, size_t stride){
+  size_t per_thread = count / self->thread_count;
+  for(size_t i = 0; i < self->thread_count; ++i){
+    self->workers[i].next = i * per_thread;
+    self->workers[i].end = i + 1 == self->thread_count ? count : (i + 1) * per_thread;
+  }
+  self->contexts = contexts;
+  self->stride = stride;
+  self->stepped = 0;
+
+  pthread_mutex_lock(&self->mutex);
+  self->busy = self->thread_count - 1;
+  self->generation++;
+  pthread_cond_broadcast(&self->start);
+  pthread_mutex_unlock(&self->mutex);
+
+  SM_Executor_work(self, 0);
+
+  pthread_mutex_lock(&self->mutex);
+  while(self->busy > 0){
+    pthread_cond_wait(&self->done, &self->mutex);
+  }
+  pthread_mutex_unlock(&self->mutex);
+  return self->stepped;
 }
 
+void SM_Executor_destroy(SM_Executor* self){
+  pthread_mutex_lock(&self->mutex);
+  self->stop = true;
+  pthread_cond_broadcast(&self->start);
+  pthread_mutex_unlock(&self->mutex);
+  for(size_t i = 1; i < self->thread_count; ++i){
+    pthread_join(self->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&self->mutex);
+  pthread_cond_destroy(&self->start);
+  pthread_cond_destroy(&self->done);
+}
+#endif // SM_EXECUTOR
+
 #endif // SM_IMPLEMENTATION
 
+#ifdef SM_CODEGEN
+// record the name of every callback expression for SM_codegen(), which only accepts names that are plain identifiers
+#define SM_State_set_enter_action(self, action) SM_State_set_enter_action_named((self), (action), #action)
+#define SM_State_set_do_action(self, action) SM_State_set_do_action_named((self), (action), #action)
+#define SM_State_set_exit_action(self, action) SM_State_set_exit_action_named((self), (action), #action)
+#define SM_Transition_set_trigger(self, trigger) SM_Transition_set_trigger_named((self), (trigger), #trigger)
+#define SM_Transition_set_guard(self, guard) SM_Transition_set_guard_named((self), (guard), #guard)
+#define SM_Transition_set_effect(self, effect) SM_Transition_set_effect_named((self), (effect), #effect)
+#endif // SM_CODEGEN
+
 #endif // SM_H_
@@ -1,6 +1,9 @@
 #define SM_IMPLEMENTATION
 #include "sm.h"
 
+#include <pthread.h>
+#include <sched.h>
+
 #include "utest.h"
 
 UTEST(SM_Transitions, initialization){
@@ -17,6 +20,27 @@ UTEST(SM_Transitions, initialization){
   ASSERT_EQ(context.current_state, SM_INITIAL_STATE);
 }
 
+// the states and transitions are static, defining them a second time would fail their redefinition asserts
+void TEST_SM_Transitions_define_once(SM* sm){
+  if(sm->init) return;
+  SM_State_create(A);
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+}
+
+UTEST(SM_Transitions, define_once){
+  SM_def(sm);
+  ASSERT_FALSE(sm->init);
+  TEST_SM_Transitions_define_once(sm);
+  ASSERT_TRUE(sm->init);
+  TEST_SM_Transitions_define_once(sm);
+  ASSERT_EQ(sm->initial_transition, sm->last_initial_transition);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_NE(context.current_state, SM_INITIAL_STATE);
+}
+
 UTEST(SM_Transitions, initial_to_other){
   SM_def(sm);
 
@@ -313,4 +337,1089 @@ UTEST(SM_States, state_do){
   ASSERT_FALSE(SM_step(sm, &context));
 }
 
+UTEST(SM_Compile, transitions_packed_per_state){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+
+  SM_compile(sm, 1024);
+
+  // every reachable transition is stored once and each state points to its own contiguous slice
+  ASSERT_TRUE(sm->compiled);
+  ASSERT_EQ(sm->transition_count, (size_t)4);
+  ASSERT_EQ(sm->initial_table.unconditional_count, (size_t)1);
+  ASSERT_EQ(A->table.unconditional_count, (size_t)2);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[0], A_to_B);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[1], A_to_final);
+  ASSERT_EQ(B->table.unconditional_count, (size_t)1);
+  ASSERT_EQ((SM_Transition*)B->table.transitions[0], B_to_A);
+
+  // states are numbered in the order they are reached, 0 is the initial/final state
+  ASSERT_EQ(sm->state_count, (size_t)3);
+  ASSERT_EQ(A->id, 1);
+  ASSERT_EQ(B->id, 2);
+  ASSERT_EQ(sm->states[0], SM_INITIAL_STATE);
+  ASSERT_EQ(sm->states[1], A);
+  ASSERT_EQ(sm->states[2], B);
+}
+
+UTEST(SM_Compile, transitions_partitioned){
+  SM_def(sm);
+
+  SM_State_create(A);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, triggered, A, SM_FINAL_STATE);
+  SM_Transition_set_trigger(triggered, TEST_SM_Transitions_trigger);
+  SM_Transition_create(sm, unconditional, A, SM_FINAL_STATE);
+  SM_Transition_create(sm, guarded, A, SM_FINAL_STATE);
+  SM_Transition_set_guard(guarded, TEST_SM_Transitions_guard);
+  SM_Transition_create(sm, guarded_trigger, A, SM_FINAL_STATE);
+  SM_Transition_set_guard(guarded_trigger, TEST_SM_Transitions_guard);
+  SM_Transition_set_trigger(guarded_trigger, TEST_SM_Transitions_trigger);
+
+  SM_compile(sm, 1024);
+
+  // guarded first, then unconditional, then anything with a trigger in creation order
+  ASSERT_EQ(A->table.guard_count, (size_t)1);
+  ASSERT_EQ(A->table.unconditional_count, (size_t)1);
+  ASSERT_EQ(A->table.trigger_count, (size_t)2);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[0], guarded);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[1], unconditional);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[2], triggered);
+  ASSERT_EQ((SM_Transition*)A->table.transitions[3], guarded_trigger);
+}
+
+UTEST(SM_Compile, same_behavior_as_chain){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_States_do);
+  
+  SM_Transition_create(sm, unguarded_transition, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, guarded_transition, SM_INITIAL_STATE, A);
+  SM_Transition_set_guard(guarded_transition, TEST_SM_Transitions_guard);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_trigger(A_to_final, TEST_SM_Transitions_trigger);
+
+  SM_compile(sm, 1024);
+
+  bool test_context = false;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+
+  // guard returns false so the unguarded transition fires
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+
+  // no eventless transition from A so the do action is called
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(test_context);
+
+  bool test_event = true;
+  ASSERT_TRUE(SM_notify(sm, &context, &test_event));
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+}
+
+SM_static_declare_state(TEST_SM_Static_A);
+SM_static_declare_transition(TEST_SM_Static_unguarded);
+SM_static_declare_transition(TEST_SM_Static_guarded);
+SM_static_declare_transition(TEST_SM_Static_A_to_final);
+
+SM_static_state(TEST_SM_Static_A, SM_static(TEST_SM_Static_A_to_final), NULL, TEST_SM_States_do, NULL);
+SM_static_transition(TEST_SM_Static_guarded, SM_INITIAL_STATE, SM_static(TEST_SM_Static_A), SM_static(TEST_SM_Static_unguarded),
+    NULL, TEST_SM_Transitions_guard, NULL);
+SM_static_transition(TEST_SM_Static_unguarded, SM_INITIAL_STATE, SM_static(TEST_SM_Static_A), NULL, NULL, NULL, NULL);
+SM_static_transition(TEST_SM_Static_A_to_final, SM_static(TEST_SM_Static_A), SM_FINAL_STATE, NULL, 
+    TEST_SM_Transitions_trigger, NULL, NULL);
+SM_static_def(TEST_SM_Static_sm, SM_static(TEST_SM_Static_guarded));
+
+UTEST(SM_Static, same_behavior_as_created){
+  bool test_context = false;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+
+  // guard returns false so the unguarded transition fires
+  ASSERT_TRUE(SM_step(TEST_SM_Static_sm, &context));
+  ASSERT_EQ((void*)context.current_state, SM_static(TEST_SM_Static_A));
+  ASSERT_STREQ(SM_State_get_trace_name(context.current_state), "TEST_SM_Static_A");
+
+  // no eventless transition from A so the do action is called
+  ASSERT_TRUE(SM_step(TEST_SM_Static_sm, &context));
+  ASSERT_TRUE(test_context);
+
+  bool test_event = true;
+  ASSERT_TRUE(SM_notify(TEST_SM_Static_sm, &context, &test_event));
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+}
+
+enum{
+  TEST_SM_Events_OPEN,
+  TEST_SM_Events_CLOSE,
+  TEST_SM_Events_RESET,
+};
+
+UTEST(SM_Events, notify_id){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, TEST_SM_Events_OPEN);
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+  SM_Transition_set_event(B_to_final, TEST_SM_Events_CLOSE);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  // event transitions never fire during SM_step() or SM_notify()
+  bool test_event = true;
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_FALSE(SM_notify(sm, &context, &test_event));
+  ASSERT_EQ(context.current_state, A);
+
+  // only a transition with a matching id fires
+  ASSERT_FALSE(SM_notify_id(sm, &context, TEST_SM_Events_CLOSE, NULL));
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_OPEN, NULL));
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_CLOSE, NULL));
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+}
+
+UTEST(SM_Events, notify_id_compiled){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, TEST_SM_Events_OPEN);
+
+  // created out of id order, the compiled table is sorted by id
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_set_event(B_to_A, TEST_SM_Events_RESET);
+  SM_Transition_set_trigger(B_to_A, TEST_SM_Transitions_trigger);
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+  SM_Transition_set_event(B_to_final, TEST_SM_Events_CLOSE);
+  SM_Transition_set_guard(B_to_final, TEST_SM_Transitions_guard);
+
+  SM_compile(sm, 1024);
+  ASSERT_EQ(B->table.event_count, (size_t)2);
+  ASSERT_EQ((SM_Transition*)B->table.transitions[0], B_to_final);
+  ASSERT_EQ((SM_Transition*)B->table.transitions[1], B_to_A);
+
+  bool test_context = false;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_OPEN, NULL));
+  ASSERT_EQ(context.current_state, B);
+
+  // the trigger refines the match on id
+  bool test_event = false;
+  ASSERT_FALSE(SM_notify_id(sm, &context, TEST_SM_Events_RESET, &test_event));
+  test_event = true;
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_RESET, &test_event));
+  ASSERT_EQ(context.current_state, A);
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_OPEN, NULL));
+
+  // the guard refines the match on id
+  ASSERT_FALSE(SM_notify_id(sm, &context, TEST_SM_Events_CLOSE, NULL));
+  test_context = true;
+  ASSERT_TRUE(SM_notify_id(sm, &context, TEST_SM_Events_CLOSE, NULL));
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+}
+
+bool TEST_SM_Queue_count_trigger(void* ctx, void* event){
+  int* test_context = ctx;
+  int* test_event = event;
+  // events must arrive in the order they were posted
+  if(*test_event != *test_context) return false;
+  (*test_context)++;
+  return true;
+}
+
+UTEST(SM_Queue, post_and_dispatch){
+  SM_def(sm);
+
+  SM_State_create(A);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_trigger(A_to_A, TEST_SM_Queue_count_trigger);
+
+  SM_QueueCell cells[4];
+  SM_Queue queue;
+  SM_Queue_init(&queue, cells, 4);
+
+  int test_context = 0;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+  SM_Context_set_queue(&context, &queue);
+  SM_step(sm, &context);
+
+  // events are kept until dispatched and posting fails once the queue is full
+  int events[5] = {0, 1, 2, 3, 4};
+  for(int i = 0; i < 4; ++i){
+    ASSERT_TRUE(SM_post(&context, &events[i]));
+  }
+  ASSERT_FALSE(SM_post(&context, &events[4]));
+  ASSERT_EQ(test_context, 0);
+
+  ASSERT_EQ(SM_dispatch(sm, &context, 3), (size_t)3);
+  ASSERT_EQ(test_context, 3);
+  ASSERT_TRUE(SM_post(&context, &events[4]));
+  ASSERT_EQ(SM_dispatch(sm, &context, 10), (size_t)2);
+  ASSERT_EQ(test_context, 5);
+  ASSERT_EQ(SM_dispatch(sm, &context, 10), (size_t)0);
+}
+
+#define TEST_SM_QUEUE_PRODUCERS 4
+#define TEST_SM_QUEUE_EVENTS 1000
+
+typedef struct{
+  SM_Context* context;
+  int event;
+} TEST_SM_Queue_Producer;
+
+void* TEST_SM_Queue_produce(void* arg){
+  TEST_SM_Queue_Producer* producer = arg;
+  for(int i = 0; i < TEST_SM_QUEUE_EVENTS; ++i){
+    while(!SM_post(producer->context, &producer->event)) sched_yield();
+  }
+  return NULL;
+}
+
+bool TEST_SM_Queue_sum_trigger(void* ctx, void* event){
+  long* test_context = ctx;
+  *test_context += *(int*)event;
+  return false;
+}
+
+UTEST(SM_Queue, multiple_producers){
+  SM_def(sm);
+
+  SM_State_create(A);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_trigger(A_to_A, TEST_SM_Queue_sum_trigger);
+
+  static SM_QueueCell cells[64];
+  SM_Queue queue;
+  SM_Queue_init(&queue, cells, 64);
+
+  long test_context = 0;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+  SM_Context_set_queue(&context, &queue);
+  SM_step(sm, &context);
+
+  pthread_t threads[TEST_SM_QUEUE_PRODUCERS];
+  TEST_SM_Queue_Producer producers[TEST_SM_QUEUE_PRODUCERS];
+  for(int i = 0; i < TEST_SM_QUEUE_PRODUCERS; ++i){
+    producers[i] = (TEST_SM_Queue_Producer){ .context = &context, .event = i + 1 };
+    pthread_create(&threads[i], NULL, TEST_SM_Queue_produce, &producers[i]);
+  }
+
+  // every posted event is dispatched exactly once
+  size_t dispatched = 0;
+  while(dispatched < TEST_SM_QUEUE_PRODUCERS * TEST_SM_QUEUE_EVENTS){
+    dispatched += SM_dispatch(sm, &context, 16);
+    sched_yield();
+  }
+  for(int i = 0; i < TEST_SM_QUEUE_PRODUCERS; ++i){
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ(test_context, (long)(1 + 2 + 3 + 4) * TEST_SM_QUEUE_EVENTS);
+}
+
+typedef struct{
+  bool test_context;
+  SM_Context context;
+} TEST_SM_Batch_Item;
+
+UTEST(SM_Batch, step_and_notify){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_States_do);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_trigger(A_to_final, TEST_SM_Transitions_trigger);
+
+  TEST_SM_Batch_Item items[16] = {0};
+  for(int i = 0; i < 16; ++i){
+    SM_Context_init(&items[i].context, &items[i].test_context);
+  }
+  items[3].context.halted = true;
+
+  // halted contexts are skipped
+  ASSERT_EQ(SM_step_batch(sm, &items[0].context, 16, sizeof(TEST_SM_Batch_Item)), (size_t)15);
+  ASSERT_EQ(items[0].context.current_state, A);
+  ASSERT_EQ(items[3].context.current_state, SM_INITIAL_STATE);
+
+  ASSERT_EQ(SM_step_batch(sm, &items[0].context, 16, sizeof(TEST_SM_Batch_Item)), (size_t)15);
+  ASSERT_TRUE(items[15].test_context);
+  ASSERT_FALSE(items[3].test_context);
+
+  bool test_event = true;
+  ASSERT_EQ(SM_notify_batch(sm, &items[0].context, 8, sizeof(TEST_SM_Batch_Item), &test_event), (size_t)7);
+  ASSERT_TRUE(SM_Context_is_halted(&items[7].context));
+  ASSERT_FALSE(SM_Context_is_halted(&items[8].context));
+}
+
+typedef struct{
+  SM_State* watched_state;
+  SM_Context* other;
+  SM_Context context;
+} TEST_SM_Sync_Item;
+
+bool TEST_SM_Sync_other_in_watched_state(void* ctx){
+  TEST_SM_Sync_Item* self = ctx;
+  return self->other->current_state == self->watched_state;
+}
+
+UTEST(SM_Batch, step_sync){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Sync_other_in_watched_state);
+
+  // each item moves to B while the other one is still in A
+  TEST_SM_Sync_Item items[2] = {0};
+  for(int i = 0; i < 2; ++i){
+    items[i].watched_state = A;
+    items[i].other = &items[1 - i].context;
+    SM_Context_init(&items[i].context, &items[i]);
+  }
+  SM_Transition* next[2];
+  ASSERT_EQ(SM_step_sync(sm, &items[0].context, 2, sizeof(TEST_SM_Sync_Item), next), (size_t)2);
+
+  // with SM_step_batch() the second item would already observe the first in B
+  ASSERT_EQ(SM_step_sync(sm, &items[0].context, 2, sizeof(TEST_SM_Sync_Item), next), (size_t)2);
+  ASSERT_EQ(items[0].context.current_state, B);
+  ASSERT_EQ(items[1].context.current_state, B);
+}
+
+typedef struct{
+  char log[32];
+  size_t length;
+  bool leave;
+} TEST_SM_Nested_Log;
+
+bool TEST_SM_Nested_leave_guard(void* ctx){
+  TEST_SM_Nested_Log* log = ctx;
+  return log->leave;
+}
+
+#define TEST_SM_NESTED_ACTION(name, ch)\
+  void TEST_SM_Nested_##name(void* ctx){\
+    TEST_SM_Nested_Log* log = ctx;\
+    log->log[log->length++] = (ch);\
+  }
+
+TEST_SM_NESTED_ACTION(enter_P, 'P')
+TEST_SM_NESTED_ACTION(exit_P, 'p')
+TEST_SM_NESTED_ACTION(enter_A, 'A')
+TEST_SM_NESTED_ACTION(exit_A, 'a')
+TEST_SM_NESTED_ACTION(enter_B, 'B')
+TEST_SM_NESTED_ACTION(exit_B, 'b')
+
+UTEST(SM_Nested, enter_exit_order_and_inherited_transitions){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_set_enter_action(P, TEST_SM_Nested_enter_P);
+  SM_State_set_exit_action(P, TEST_SM_Nested_exit_P);
+
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_set_enter_action(A, TEST_SM_Nested_enter_A);
+  SM_State_set_exit_action(A, TEST_SM_Nested_exit_A);
+
+  SM_State_create(B);
+  SM_State_set_parent(B, P);
+  SM_State_set_enter_action(B, TEST_SM_Nested_enter_B);
+  SM_State_set_exit_action(B, TEST_SM_Nested_exit_B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_trigger(A_to_B, TEST_SM_Transitions_trigger);
+
+  // inherited by both A and B
+  SM_Transition_create(sm, P_to_final, P, SM_FINAL_STATE);
+  SM_Transition_set_guard(P_to_final, TEST_SM_Nested_leave_guard);
+  SM_Transition_create(sm, P_to_A, P, A);
+  SM_Transition_set_event(P_to_A, 0);
+
+  SM_compile(sm, 1024);
+  ASSERT_EQ(A_to_B->lca, P);
+  ASSERT_EQ(B->table.guard_count, (size_t)1);
+
+  TEST_SM_Nested_Log log = {0};
+  SM_Context context;
+  SM_Context_init(&context, &log);
+
+  // the parent is entered before the child
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+  ASSERT_STREQ(log.log, "PA");
+
+  // transitions between siblings don't exit the parent
+  bool test_event = true;
+  ASSERT_TRUE(SM_notify(sm, &context, &test_event));
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_STREQ(log.log, "PAaB");
+
+  // an inherited transition from the parent to its child re-enters the parent
+  ASSERT_TRUE(SM_notify_id(sm, &context, 0, NULL));
+  ASSERT_EQ(context.current_state, A);
+  ASSERT_STREQ(log.log, "PAaBbpPA");
+
+  // the guard of the parent is checked while a child is active
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+
+  // the child is exited before the parent
+  log.leave = true;
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+  ASSERT_STREQ(log.log, "PAaBbpPAap");
+}
+
+UTEST(SM_Nested, own_transitions_take_precedence){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_create(B);
+  SM_State_set_parent(B, P);
+  SM_State_create(X);
+  SM_State_create(Y);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_X, A, X);
+  SM_Transition_create(sm, P_to_Y, P, Y);
+  SM_Transition_set_guard(P_to_Y, TEST_SM_Transitions_guard);
+  SM_Transition_create(sm, X_to_B, X, B);
+  SM_compile(sm, 1024);
+
+  // the guard of the parent is never checked while A is active
+  ASSERT_EQ(A->table.guard_count, (size_t)0);
+  ASSERT_EQ(B->table.guard_count, (size_t)1);
+
+  bool test_context = true;
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, X);
+
+  // without transitions of its own B takes the one of its parent
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, Y);
+}
+
+UTEST(SM_Timers, timeout_transitions){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_timeout(A_to_B, 10);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_trigger(A_to_A, TEST_SM_Transitions_trigger);
+
+  // spans multiple levels of the timing wheel
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+  SM_Transition_set_timeout(B_to_final, 100000);
+  SM_compile(sm, 1024);
+
+  SM_Timers timers;
+  SM_Timers_init(&timers, 1000);
+  SM_Timer timer;
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  SM_Context_set_timer(&context, sm, &timers, &timer);
+
+  // timeouts never fire during SM_step()
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+
+  // re-entering A through a self transition restarts the timeout
+  ASSERT_EQ(SM_Timers_advance(&timers, 1005), (size_t)0);
+  bool test_event = true;
+  ASSERT_TRUE(SM_notify(sm, &context, &test_event));
+  ASSERT_EQ(SM_Timers_advance(&timers, 1014), (size_t)0);
+  ASSERT_EQ(context.current_state, A);
+  ASSERT_EQ(SM_Timers_advance(&timers, 1015), (size_t)1);
+  ASSERT_EQ(context.current_state, B);
+
+  ASSERT_EQ(SM_Timers_advance(&timers, 101014), (size_t)0);
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_EQ(SM_Timers_advance(&timers, 101015), (size_t)1);
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+  ASSERT_EQ(timers.count, (size_t)0);
+}
+
+UTEST(SM_Timers, guarded_timeouts){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+
+  // created in reverse order, the shortest timeout is armed first
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_timeout(A_to_final, 200);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_timeout(A_to_B, 100);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Transitions_guard);
+  SM_compile(sm, 1024);
+
+  SM_Timers timers;
+  SM_Timers_init(&timers, 0);
+  enum{ count = 100 };
+  SM_Timer timer[count];
+  SM_Context context[count];
+  bool test_context[count];
+  for(int i = 0; i < count; ++i){
+    test_context[i] = i % 2 == 0;
+    SM_Context_init(&context[i], &test_context[i]);
+    SM_Context_set_timer(&context[i], sm, &timers, &timer[i]);
+    SM_Timers_advance(&timers, i);
+    SM_step(sm, &context[i]);
+  }
+
+  // the guard blocks the first timeout for odd contexts which then wait for the second
+  ASSERT_EQ(SM_Timers_advance(&timers, 199), (size_t)count);
+  for(int i = 0; i < count; ++i){
+    ASSERT_EQ(context[i].current_state, i % 2 == 0 ? B : A);
+  }
+  ASSERT_EQ(SM_Timers_advance(&timers, 298), (size_t)count / 2 - 1);
+  ASSERT_TRUE(SM_Context_is_halted(&context[97]));
+  ASSERT_FALSE(SM_Context_is_halted(&context[99]));
+  ASSERT_EQ(SM_Timers_advance(&timers, 299), (size_t)1);
+  ASSERT_TRUE(SM_Context_is_halted(&context[99]));
+}
+
+UTEST(SM_Timers, set_timer_while_armed){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_timeout(A_to_final, 10);
+  SM_compile(sm, 1024);
+
+  SM_Timers timers;
+  SM_Timers_init(&timers, 0);
+  SM_Timer timers_of_context[2];
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  // the timeout of the current state is armed once the timer is set
+  SM_Context_set_timer(&context, sm, &timers, &timers_of_context[0]);
+  ASSERT_EQ(timers.count, (size_t)1);
+
+  // setting a timer again disarms the previous one first
+  ASSERT_EQ(SM_Timers_advance(&timers, 5), (size_t)0);
+  SM_Context_set_timer(&context, sm, &timers, &timers_of_context[0]);
+  SM_Context_set_timer(&context, sm, &timers, &timers_of_context[1]);
+  ASSERT_EQ(timers.count, (size_t)1);
+  ASSERT_FALSE(timers_of_context[0].armed);
+  ASSERT_EQ(SM_Timers_advance(&timers, 14), (size_t)0);
+  ASSERT_EQ(SM_Timers_advance(&timers, 15), (size_t)1);
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+  ASSERT_EQ(timers.count, (size_t)0);
+}
+
+UTEST(SM_Timers, inherited_timeouts){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_create(B);
+  SM_State_set_parent(B, P);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_timeout(A_to_B, 4);
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_set_timeout(B_to_A, 4);
+
+  // inherited by A and B, switching between them doesn't exit P
+  SM_Transition_create(sm, P_to_final, P, SM_FINAL_STATE);
+  SM_Transition_set_timeout(P_to_final, 10);
+  SM_compile(sm, 1024);
+
+  SM_Timers timers;
+  SM_Timers_init(&timers, 0);
+  SM_Timer timer;
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  SM_Context_set_timer(&context, sm, &timers, &timer);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  ASSERT_EQ(SM_Timers_advance(&timers, 4), (size_t)1);
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_EQ(SM_Timers_advance(&timers, 8), (size_t)1);
+  ASSERT_EQ(context.current_state, A);
+
+  // P's timeout is counted from when P was entered, not from when A was entered again
+  ASSERT_EQ(SM_Timers_advance(&timers, 9), (size_t)0);
+  ASSERT_EQ(SM_Timers_advance(&timers, 10), (size_t)1);
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+  ASSERT_EQ(timers.count, (size_t)0);
+}
+
+UTEST(SM_Regions, step_and_notify_all_regions){
+  SM_def(link);
+  SM_def(auth);
+
+  SM_State_create(link_down);
+  SM_State_create(link_up);
+  SM_Transition_create(link, initial_to_link_down, SM_INITIAL_STATE, link_down);
+  SM_Transition_create(link, link_down_to_up, link_down, link_up);
+  SM_Transition_set_event(link_down_to_up, TEST_SM_Events_OPEN);
+  SM_Transition_create(link, link_up_to_final, link_up, SM_FINAL_STATE);
+  SM_Transition_set_event(link_up_to_final, TEST_SM_Events_CLOSE);
+
+  SM_State_create(auth_none);
+  SM_State_create(auth_done);
+  SM_Transition_create(auth, initial_to_auth_none, SM_INITIAL_STATE, auth_none);
+  SM_Transition_create(auth, auth_none_to_done, auth_none, auth_done);
+  SM_Transition_set_event(auth_none_to_done, TEST_SM_Events_OPEN);
+  SM_Transition_create(auth, auth_done_to_none, auth_done, auth_none);
+  SM_Transition_set_trigger(auth_done_to_none, TEST_SM_Transitions_trigger);
+
+  SM* regions[2] = {link, auth};
+  SM_State* current_states[2];
+  SM_RegionContext context;
+  SM_RegionContext_init(&context, regions, current_states, 2, NULL);
+
+  // every region performs its initial transition in the same step
+  ASSERT_TRUE(SM_RegionContext_step(&context));
+  ASSERT_EQ(current_states[0], link_down);
+  ASSERT_EQ(current_states[1], auth_none);
+
+  // an event is passed to every region
+  ASSERT_TRUE(SM_RegionContext_notify_id(&context, TEST_SM_Events_OPEN, NULL));
+  ASSERT_EQ(current_states[0], link_up);
+  ASSERT_EQ(current_states[1], auth_done);
+
+  bool test_event = true;
+  ASSERT_TRUE(SM_RegionContext_notify(&context, &test_event));
+  ASSERT_EQ(current_states[0], link_up);
+  ASSERT_EQ(current_states[1], auth_none);
+
+  // halted regions are skipped while the others keep running
+  ASSERT_TRUE(SM_RegionContext_notify_id(&context, TEST_SM_Events_CLOSE, NULL));
+  ASSERT_FALSE(SM_RegionContext_is_halted(&context));
+  ASSERT_EQ(context.halted, (uint64_t)1);
+  ASSERT_TRUE(SM_RegionContext_step(&context));
+  ASSERT_FALSE(SM_RegionContext_notify_id(&context, TEST_SM_Events_CLOSE, NULL));
+}
+
+UTEST(SM_ContextPool, step_and_notify){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_States_do);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_trigger(A_to_final, TEST_SM_Transitions_trigger);
+  SM_compile(sm, 1024);
+
+  enum{ count = 130 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  bool test_context[count] = {0};
+  void* user_contexts[count];
+  for(int i = 0; i < count; ++i){
+    user_contexts[i] = &test_context[i];
+  }
+
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, user_contexts, count);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 0), SM_INITIAL_STATE);
+
+  ASSERT_EQ(SM_ContextPool_step_all(&pool), (size_t)count);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 129), A);
+  ASSERT_EQ(states[129], A->id);
+  ASSERT_TRUE(SM_ContextPool_step(&pool, 7));
+  ASSERT_TRUE(test_context[7]);
+  ASSERT_FALSE(test_context[8]);
+
+  bool test_event = true;
+  ASSERT_TRUE(SM_ContextPool_notify(&pool, 7, &test_event));
+  ASSERT_TRUE(SM_ContextPool_is_halted(&pool, 7));
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 7), SM_FINAL_STATE);
+  ASSERT_FALSE(SM_ContextPool_step(&pool, 7));
+  ASSERT_EQ(SM_ContextPool_notify_all(&pool, &test_event), (size_t)count - 1);
+  ASSERT_EQ(SM_ContextPool_step_all(&pool), (size_t)0);
+
+  SM_ContextPool_reset(&pool, 7);
+  ASSERT_FALSE(SM_ContextPool_is_halted(&pool, 7));
+  ASSERT_EQ(SM_ContextPool_step_all(&pool), (size_t)1);
+}
+
+UTEST(SM_ContextPool, active_set){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_State_set_do_action(B, TEST_SM_States_do);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Transitions_guard);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_trigger(A_to_final, TEST_SM_Transitions_trigger);
+  SM_compile(sm, 1024);
+
+  enum{ count = 130 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  uint64_t active[SM_CONTEXT_POOL_WORDS(count)];
+  bool test_context[count] = {0};
+  void* user_contexts[count];
+  for(int i = 0; i < count; ++i){
+    user_contexts[i] = &test_context[i];
+  }
+
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, user_contexts, count);
+  ASSERT_FALSE(SM_ContextPool_is_parked(&pool, 0));
+  SM_ContextPool_set_active(&pool, active);
+
+  // the initial transitions keep every context runnable, the step after that changes nothing and parks them
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)count);
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)count);
+  ASSERT_TRUE(SM_ContextPool_is_parked(&pool, 129));
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)0);
+
+  // guards of parked contexts are only checked again once they are woken
+  test_context[5] = true;
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)0);
+  SM_ContextPool_wake(&pool, 5);
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)1);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 5), B);
+
+  // states with a do_action stay runnable
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)1);
+  ASSERT_FALSE(SM_ContextPool_is_parked(&pool, 5));
+
+  // notifying wakes a context even if the event isn't handled
+  bool test_event = false;
+  ASSERT_FALSE(SM_ContextPool_notify(&pool, 7, &test_event));
+  ASSERT_FALSE(SM_ContextPool_is_parked(&pool, 7));
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)2);
+  ASSERT_TRUE(SM_ContextPool_is_parked(&pool, 7));
+
+  test_event = true;
+  ASSERT_TRUE(SM_ContextPool_notify(&pool, 7, &test_event));
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)1);
+  SM_ContextPool_reset(&pool, 7);
+  ASSERT_EQ(SM_ContextPool_step_active(&pool), (size_t)2);
+}
+
+UTEST(SM_Snapshot, context){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_event(A_to_final, 1);
+  SM_compile(sm, 1024);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  uint8_t buffer[SM_CONTEXT_SERIALIZED_SIZE];
+  ASSERT_EQ(SM_Context_serialize(sm, &context, buffer, sizeof(buffer)), (size_t)SM_CONTEXT_SERIALIZED_SIZE);
+  SM_Context restored;
+  SM_Context_init(&restored, NULL);
+  ASSERT_TRUE(SM_Context_deserialize(sm, &restored, buffer, sizeof(buffer)));
+  ASSERT_EQ(restored.current_state, A);
+  ASSERT_FALSE(restored.halted);
+
+  ASSERT_TRUE(SM_notify_id(sm, &context, 1, NULL));
+  SM_Context_serialize(sm, &context, buffer, sizeof(buffer));
+  ASSERT_TRUE(SM_Context_deserialize(sm, &restored, buffer, sizeof(buffer)));
+  ASSERT_EQ(restored.current_state, SM_FINAL_STATE);
+  ASSERT_TRUE(restored.halted);
+
+  // parents can't be current and ids past the last state don't exist
+  SM_Context_init(&restored, NULL);
+  const uint8_t parent[] = { (uint8_t)P->id, 0, 0 };
+  const uint8_t missing[] = { 0xff, 0, 0 };
+  ASSERT_FALSE(SM_Context_deserialize(sm, &restored, parent, sizeof(parent)));
+  ASSERT_FALSE(SM_Context_deserialize(sm, &restored, missing, sizeof(missing)));
+  ASSERT_FALSE(SM_Context_deserialize(sm, &restored, buffer, 2));
+  ASSERT_EQ(restored.current_state, SM_INITIAL_STATE);
+}
+
+UTEST(SM_Snapshot, pool_file){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+  SM_Transition_set_event(B_to_final, 2);
+  SM_compile(sm, 1024);
+
+  enum{ count = 70 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, NULL, count);
+  SM_ContextPool_step_all(&pool);
+  for(size_t i = 0; i < count; i += 3){
+    SM_Context context;
+    SM_ContextPool_load(&pool, i, &context);
+    SM_notify_id(sm, &context, 1, NULL);
+    if(i % 2 == 0) SM_notify_id(sm, &context, 2, NULL);
+    SM_ContextPool_store(&pool, i, &context);
+  }
+
+  static uint64_t file[64];
+  size_t size = SM_ContextPool_file_size(count);
+  ASSERT_LE(size, sizeof(file));
+  ASSERT_EQ(SM_ContextPool_save_file(&pool, file, sizeof(file)), size);
+
+  uint16_t restored_states[count];
+  uint64_t restored_halted[SM_CONTEXT_POOL_WORDS(count)];
+  SM_ContextPool restored;
+  SM_ContextPool_init(&restored, sm, restored_states, restored_halted, NULL, count);
+  ASSERT_TRUE(SM_ContextPool_load_file(&restored, file, size));
+  for(size_t i = 0; i < count; ++i){
+    ASSERT_EQ(SM_ContextPool_get_state(&restored, i), SM_ContextPool_get_state(&pool, i));
+    ASSERT_EQ(SM_ContextPool_is_halted(&restored, i), SM_ContextPool_is_halted(&pool, i));
+  }
+  ASSERT_TRUE(SM_ContextPool_is_halted(&restored, 0));
+  ASSERT_EQ(SM_ContextPool_get_state(&restored, 3), B);
+
+  // truncated files, other pool sizes and corrupted state ids are rejected
+  ASSERT_FALSE(SM_ContextPool_load_file(&restored, file, size - 1));
+  SM_ContextPool smaller;
+  SM_ContextPool_init(&smaller, sm, restored_states, restored_halted, NULL, count - 1);
+  ASSERT_FALSE(SM_ContextPool_load_file(&smaller, file, size));
+  ((SM_PoolFileHeader*)file)->fingerprint ^= 1;
+  ASSERT_FALSE(SM_ContextPool_load_file(&restored, file, size));
+  ((SM_PoolFileHeader*)file)->fingerprint ^= 1;
+  ((uint16_t*)file)[size / sizeof(uint16_t) - 1] = 0xff;
+  ASSERT_FALSE(SM_ContextPool_load_file(&restored, file, size));
+}
+
+UTEST(SM_Bytes, byte_class){
+  ASSERT_TRUE(SM_byte_class_contains("a-zA-Z_", 'q'));
+  ASSERT_TRUE(SM_byte_class_contains("a-zA-Z_", 'Z'));
+  ASSERT_TRUE(SM_byte_class_contains("a-zA-Z_", '_'));
+  ASSERT_FALSE(SM_byte_class_contains("a-zA-Z_", '-'));
+  ASSERT_TRUE(SM_byte_class_contains("0-9-", '-'));
+  ASSERT_TRUE(SM_byte_class_contains("-+", '-'));
+  ASSERT_FALSE(SM_byte_class_contains("^,\n", ','));
+  ASSERT_TRUE(SM_byte_class_contains("^,\n", 0xff));
+}
+
+typedef struct{
+  char bytes[16];
+  size_t length;
+} TEST_SM_Bytes_Log;
+
+void TEST_SM_Bytes_effect(void* ctx, const uint8_t* bytes, size_t length){
+  TEST_SM_Bytes_Log* log = ctx;
+  memcpy(&log->bytes[log->length], bytes, length);
+  log->length += length;
+}
+
+UTEST(SM_Bytes, feed_bytes){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_byte_class(A_to_A, "a-z");
+  SM_Transition_set_byte_effect(A_to_A, TEST_SM_Bytes_effect);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_byte_class(A_to_B, "a-z0-9"); // overlaps A_to_A, which is created first
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+  SM_Transition_set_byte_class(B_to_final, ";");
+
+  SM_compile(sm, 2048);
+  ASSERT_EQ(A->table.byte_count, (size_t)2);
+  ASSERT_EQ(A->table.byte_table['a'], 1);
+  ASSERT_EQ(A->table.byte_table['7'], 2);
+  ASSERT_EQ(A->table.byte_table[';'], 0);
+
+  TEST_SM_Bytes_Log log = {0};
+  SM_Context context;
+  SM_Context_init(&context, &log);
+
+  // no byte transitions from the initial state
+  ASSERT_EQ(SM_feed_bytes(sm, &context, "abc", 3), (size_t)0);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  // stops at the first byte without a transition from the current state
+  ASSERT_EQ(SM_feed_bytes(sm, &context, "abc7!", 5), (size_t)4);
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_EQ(log.length, (size_t)3);
+  ASSERT_EQ(memcmp(log.bytes, "abc", 3), 0);
+
+  // stops once halted
+  ASSERT_EQ(SM_feed_bytes(sm, &context, ";;", 2), (size_t)1);
+  ASSERT_TRUE(SM_Context_is_halted(&context));
+}
+
+typedef struct{
+  size_t calls;
+  size_t length;
+  size_t parent_exits;
+  bool exited;
+} TEST_SM_Bytes_Runs;
+
+void TEST_SM_Bytes_run_effect(void* ctx, const uint8_t* bytes, size_t length){
+  (void)(bytes);
+  TEST_SM_Bytes_Runs* runs = ctx;
+  runs->calls++;
+  runs->length += length;
+}
+
+void TEST_SM_Bytes_exit(void* ctx){
+  TEST_SM_Bytes_Runs* runs = ctx;
+  runs->exited = true;
+}
+
+void TEST_SM_Bytes_parent_exit(void* ctx){
+  TEST_SM_Bytes_Runs* runs = ctx;
+  runs->parent_exits++;
+}
+
+UTEST(SM_Bytes, self_loop_runs){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_State_create(C);
+  SM_State_set_exit_action(C, TEST_SM_Bytes_exit);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_byte_class(A_to_A, "a-z0-9_");
+  SM_Transition_set_byte_effect(A_to_A, TEST_SM_Bytes_run_effect);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_byte_class(A_to_B, ",");
+  SM_Transition_create(sm, B_to_B, B, B); // too many ranges for SIMD
+  SM_Transition_set_byte_class(B_to_B, "acegikmoq");
+  SM_Transition_set_byte_effect(B_to_B, TEST_SM_Bytes_run_effect);
+  SM_Transition_create(sm, B_to_C, B, C);
+  SM_Transition_set_byte_class(B_to_C, ",");
+  SM_Transition_create(sm, C_to_C, C, C); // exit action so every byte is a transition
+  SM_Transition_set_byte_class(C_to_C, "x");
+  SM_Transition_set_byte_effect(C_to_C, TEST_SM_Bytes_run_effect);
+
+  SM_compile(sm, 4096);
+  ASSERT_EQ(A->table.byte_run, 1);
+  ASSERT_EQ(A->table.byte_run_range_count, 3);
+  ASSERT_EQ(B->table.byte_run, 1);
+  ASSERT_EQ(B->table.byte_run_range_count, 0);
+  ASSERT_EQ(C->table.byte_run, 0);
+
+  static char input[256];
+  size_t length = 0;
+  for(size_t i = 0; i < 100; ++i) input[length++] = "abz09_"[i % 6];
+  input[length++] = ',';
+  for(size_t i = 0; i < 37; ++i) input[length++] = "acq"[i % 3];
+  input[length++] = ',';
+  for(size_t i = 0; i < 5; ++i) input[length++] = 'x';
+  input[length++] = '!';
+
+  TEST_SM_Bytes_Runs runs = {0};
+  SM_Context context;
+  SM_Context_init(&context, &runs);
+  ASSERT_TRUE(SM_step(sm, &context));
+
+  ASSERT_EQ(SM_feed_bytes(sm, &context, input, length), length - 1);
+  ASSERT_EQ(context.current_state, C);
+  ASSERT_EQ(runs.calls, (size_t)(1 + 1 + 5));
+  ASSERT_EQ(runs.length, (size_t)(100 + 37 + 5));
+  ASSERT_TRUE(runs.exited);
+
+  // runs stop in the middle of a chunk
+  SM_Context_init(&context, &runs);
+  runs = (TEST_SM_Bytes_Runs){0};
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(SM_feed_bytes(sm, &context, input + 3, 40), (size_t)40);
+  ASSERT_EQ(SM_feed_bytes(sm, &context, input + 43, 57), (size_t)57);
+  ASSERT_EQ(runs.calls, (size_t)2);
+  ASSERT_EQ(runs.length, (size_t)97);
+  ASSERT_EQ(SM_feed_bytes(sm, &context, "ab!", 3), (size_t)2);
+  ASSERT_EQ(runs.length, (size_t)99);
+}
+
+UTEST(SM_Bytes, inherited_self_loop){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_set_exit_action(P, TEST_SM_Bytes_parent_exit);
+  SM_State_create(C);
+  SM_State_set_parent(C, P);
+
+  SM_Transition_create(sm, initial_to_C, SM_INITIAL_STATE, C);
+  // inherited by C, exits and enters P on every byte
+  SM_Transition_create(sm, P_to_C, P, C);
+  SM_Transition_set_byte_class(P_to_C, "a-z");
+  SM_Transition_set_byte_effect(P_to_C, TEST_SM_Bytes_run_effect);
+
+  SM_compile(sm, 1024);
+  ASSERT_EQ(C->table.byte_run, 0);
+
+  static char input[40];
+  memset(input, 'a', sizeof(input));
+  TEST_SM_Bytes_Runs runs = {0};
+  SM_Context context;
+  SM_Context_init(&context, &runs);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(SM_feed_bytes(sm, &context, input, sizeof(input)), sizeof(input));
+  ASSERT_EQ(runs.parent_exits, sizeof(input));
+  ASSERT_EQ(runs.calls, sizeof(input));
+}
+
 UTEST_MAIN();
@@ -0,0 +1,152 @@
+#define SM_IMPLEMENTATION
+#define SM_CODEGEN
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_CODEGEN stringifies callbacks passed to the setters so it is tested in a separate translation unit
+
+bool TEST_SM_Transitions_guard(void* ctx){
+  bool* test_context = ctx;
+  return *test_context;
+}
+
+bool TEST_SM_Transitions_trigger(void* ctx, void* event){
+  bool* test_event = event;
+  return *test_event;
+}
+
+void TEST_SM_States_do(void* ctx){
+  bool* test_context = ctx;
+  *test_context = true;
+}
+
+typedef struct{
+  char log[32];
+  size_t length;
+  bool leave;
+} TEST_SM_Nested_Log;
+
+bool TEST_SM_Nested_leave_guard(void* ctx){
+  TEST_SM_Nested_Log* log = ctx;
+  return log->leave;
+}
+
+#define TEST_SM_NESTED_ACTION(name, ch)\
+  void TEST_SM_Nested_##name(void* ctx){\
+    TEST_SM_Nested_Log* log = ctx;\
+    log->log[log->length++] = (ch);\
+  }
+
+TEST_SM_NESTED_ACTION(exit_P, 'p')
+TEST_SM_NESTED_ACTION(enter_A, 'A')
+TEST_SM_NESTED_ACTION(exit_A, 'a')
+
+// reads back everything written to the file
+size_t TEST_SM_Codegen_read(FILE* file, char* buffer, size_t size){
+  rewind(file);
+  size_t length = fread(buffer, 1, size - 1, file);
+  buffer[length] = '\0';
+  return length;
+}
+
+UTEST(SM_Codegen, nested_state_machine){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_set_exit_action(P, TEST_SM_Nested_exit_P);
+
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_set_enter_action(A, TEST_SM_Nested_enter_A);
+  SM_State_set_exit_action(A, TEST_SM_Nested_exit_A);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, P_to_final, P, SM_FINAL_STATE);
+  SM_Transition_set_guard(P_to_final, TEST_SM_Nested_leave_guard);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_trigger(A_to_A, TEST_SM_Transitions_trigger);
+  SM_Transition_set_event(A_to_A, 3);
+
+  SM_compile(sm, 1024);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  ASSERT_TRUE(SM_codegen(sm, file, "test"));
+  static char source[8192];
+  ASSERT_LT(TEST_SM_Codegen_read(file, source, sizeof(source)), sizeof(source) - 1);
+  fclose(file);
+
+  // callbacks are declared once and called by name
+  const char* guard = "bool TEST_SM_Nested_leave_guard(void* user_context);\n";
+  ASSERT_TRUE(strstr(source, guard) != NULL);
+  ASSERT_TRUE(strstr(strstr(source, guard) + 1, guard) == NULL);
+  ASSERT_TRUE(strstr(source, "  test_STATE_A = 1,\n") != NULL);
+
+  // the inherited transition exits the child before the parent and halts
+  ASSERT_TRUE(strstr(source, 
+    "      if(TEST_SM_Nested_leave_guard(user_context)){\n"
+    "        // P_to_final\n"
+    "        TEST_SM_Nested_exit_A(user_context);\n"
+    "        TEST_SM_Nested_exit_P(user_context);\n"
+    "        self->current_state = test_STATE_INITIAL;\n"
+    "        self->halted = true;\n") != NULL);
+  ASSERT_TRUE(strstr(source, "      if(event_id == 3 && TEST_SM_Transitions_trigger(user_context, event)){\n") != NULL);
+
+  // the parent is never current and has no case, so every switch needs a default
+  ASSERT_TRUE(strstr(source, "    default:\n      return true;\n  }\n}\n\nbool test_notify(") != NULL);
+}
+
+UTEST(SM_Codegen, unnamed_callback){
+  SM_def(sm);
+
+  SM_State_create(A);
+  A->do_action = TEST_SM_States_do;
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_compile(sm, 1024);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  ASSERT_FALSE(SM_codegen(sm, file, "test"));
+  static char source[1024];
+  TEST_SM_Codegen_read(file, source, sizeof(source));
+  fclose(file);
+  ASSERT_TRUE(strstr(source, "#error") != NULL);
+}
+
+UTEST(SM_Codegen, callback_names){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_States_do);
+  SM_State_create(B);
+  SM_State_set_do_action(B, TEST_SM_States_do);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Transitions_guard);
+  SM_compile(sm, 1024);
+
+  // the do_action shared by both states is declared once
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  ASSERT_TRUE(SM_codegen(sm, file, "test"));
+  static char source[4096];
+  TEST_SM_Codegen_read(file, source, sizeof(source));
+  fclose(file);
+  const char* action = "void TEST_SM_States_do(void* user_context);\n";
+  ASSERT_TRUE(strstr(source, action) != NULL);
+  ASSERT_TRUE(strstr(strstr(source, action) + 1, action) == NULL);
+
+  // the name of a callback expression can't be called in the generated code
+  SM_Transition_set_guard(A_to_B, &TEST_SM_Transitions_guard);
+  file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  ASSERT_FALSE(SM_codegen(sm, file, "test"));
+  TEST_SM_Codegen_read(file, source, sizeof(source));
+  fclose(file);
+  ASSERT_TRUE(strstr(source, "#error \"state machine 'test': callback of 'A_to_B' is not named by a plain identifier") != NULL);
+}
+
+UTEST_MAIN();
@@ -0,0 +1,219 @@
+#define SM_IMPLEMENTATION
+#define SM_DIRTY
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_DIRTY changes when guards are checked so it is tested in a separate translation unit
+
+typedef struct{
+  bool ready;
+  size_t guard_calls;
+  size_t do_calls;
+  SM_Context* neighbor;
+} TEST_SM_Dirty_Context;
+
+bool TEST_SM_Dirty_ready_guard(void* ctx){
+  TEST_SM_Dirty_Context* self = ctx;
+  self->guard_calls++;
+  return self->ready;
+}
+
+void TEST_SM_Dirty_do(void* ctx){
+  TEST_SM_Dirty_Context* self = ctx;
+  self->do_calls++;
+}
+
+void TEST_SM_Dirty_invalidate_neighbor(void* ctx){
+  TEST_SM_Dirty_Context* self = ctx;
+  if(self->neighbor) SM_Context_invalidate(self->neighbor);
+}
+
+UTEST(SM_Dirty, skips_clean_contexts){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_Dirty_do);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Dirty_ready_guard);
+  SM_compile(sm, 1024);
+
+  TEST_SM_Dirty_Context test_context = {0};
+  SM_Context context;
+  SM_Context_init(&context, &test_context);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+
+  // the guards of a newly entered state are checked once, afterwards only the do_action is called
+  for(size_t i = 0; i < 3; ++i) ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(test_context.guard_calls, (size_t)1);
+  ASSERT_EQ(test_context.do_calls, (size_t)3);
+
+  // changes the guard doesn't know about are missed until the context is invalidated
+  test_context.ready = true;
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, A);
+  SM_Context_invalidate(&context);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_EQ(context.current_state, B);
+  ASSERT_EQ(test_context.guard_calls, (size_t)2);
+}
+
+UTEST(SM_Dirty, step_sync_keeps_invalidations){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_State_set_enter_action(B, TEST_SM_Dirty_invalidate_neighbor);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Dirty_ready_guard);
+  SM_compile(sm, 1024);
+
+  TEST_SM_Dirty_Context test_contexts[2] = {0};
+  SM_Context contexts[2];
+  SM_Transition* next[2];
+  for(size_t i = 0; i < 2; ++i) SM_Context_init(&contexts[i], &test_contexts[i]);
+  test_contexts[0].neighbor = &contexts[1];
+  SM_step_sync(sm, contexts, 2, sizeof(SM_Context), next);
+  SM_step_sync(sm, contexts, 2, sizeof(SM_Context), next);
+  ASSERT_FALSE(contexts[1].dirty);
+
+  // the first context entering B invalidates the second one, whose step in the same batch must not clear it
+  test_contexts[0].ready = true;
+  test_contexts[1].ready = true;
+  SM_Context_invalidate(&contexts[0]);
+  SM_step_sync(sm, contexts, 2, sizeof(SM_Context), next);
+  ASSERT_EQ(contexts[0].current_state, B);
+  ASSERT_EQ(contexts[1].current_state, A);
+  ASSERT_TRUE(contexts[1].dirty);
+  SM_step_sync(sm, contexts, 2, sizeof(SM_Context), next);
+  ASSERT_EQ(contexts[1].current_state, B);
+}
+
+UTEST(SM_Dirty, pool_step_dirty){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Dirty_ready_guard);
+  SM_compile(sm, 1024);
+
+  enum{ count = 200 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  uint64_t dirty[SM_CONTEXT_POOL_WORDS(count)];
+  static TEST_SM_Dirty_Context test_contexts[count];
+  void* user_contexts[count];
+  for(size_t i = 0; i < count; ++i) user_contexts[i] = &test_contexts[i];
+
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, user_contexts, count);
+  SM_ContextPool_set_dirty(&pool, dirty);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)count); // initial transitions
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)count); // guards of A
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)0);
+
+  test_contexts[5].ready = true;
+  test_contexts[150].ready = true;
+  SM_ContextPool_invalidate(&pool, 5);
+  SM_ContextPool_invalidate(&pool, 150);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)2);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 5), B);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 150), B);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 6), A);
+  ASSERT_EQ(test_contexts[6].guard_calls, (size_t)1);
+}
+
+// changes what the guard reads without handling the event
+bool TEST_SM_Dirty_ready_trigger(void* ctx, void* event){
+  (void)(event);
+  TEST_SM_Dirty_Context* self = ctx;
+  self->ready = true;
+  return false;
+}
+
+UTEST(SM_Dirty, pool_notify){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Dirty_ready_guard);
+  SM_Transition_create(sm, A_to_A, A, A);
+  SM_Transition_set_trigger(A_to_A, TEST_SM_Dirty_ready_trigger);
+  SM_compile(sm, 1024);
+
+  enum{ count = 10 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  uint64_t dirty[SM_CONTEXT_POOL_WORDS(count)];
+  static TEST_SM_Dirty_Context test_contexts[count];
+  void* user_contexts[count];
+  for(size_t i = 0; i < count; ++i) user_contexts[i] = &test_contexts[i];
+
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, user_contexts, count);
+  SM_ContextPool_set_dirty(&pool, dirty);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)count);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)count);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)0);
+
+  // a notified context is dirty even if it didn't handle the event
+  ASSERT_FALSE(SM_ContextPool_notify(&pool, 3, NULL));
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)1);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 3), B);
+}
+
+UTEST(SM_Dirty, pool_reset_and_restore){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_guard(A_to_B, TEST_SM_Dirty_ready_guard);
+  SM_compile(sm, 1024);
+
+  enum{ count = 70 };
+  uint16_t states[count];
+  uint64_t halted[SM_CONTEXT_POOL_WORDS(count)];
+  uint64_t dirty[SM_CONTEXT_POOL_WORDS(count)];
+  static TEST_SM_Dirty_Context test_contexts[count];
+  void* user_contexts[count];
+  for(size_t i = 0; i < count; ++i) user_contexts[i] = &test_contexts[i];
+
+  SM_ContextPool pool;
+  SM_ContextPool_init(&pool, sm, states, halted, user_contexts, count);
+  SM_ContextPool_set_dirty(&pool, dirty);
+  SM_ContextPool_step_dirty(&pool);
+  SM_ContextPool_step_dirty(&pool);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)0);
+
+  // a reset context has to take its initial transition again
+  SM_ContextPool_reset(&pool, 3);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)1);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 3), A);
+
+  // restored contexts check their guards again
+  static uint64_t file[64];
+  ASSERT_TRUE(SM_ContextPool_save_file(&pool, file, sizeof(file)));
+  SM_ContextPool_step_dirty(&pool);
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)0);
+  test_contexts[64].ready = true;
+  ASSERT_TRUE(SM_ContextPool_load_file(&pool, file, sizeof(file)));
+  ASSERT_EQ(SM_ContextPool_step_dirty(&pool), (size_t)count);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 64), B);
+}
+
+UTEST_MAIN();
@@ -0,0 +1,46 @@
+#define SM_IMPLEMENTATION
+#define SM_EXECUTOR
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_EXECUTOR starts worker threads so it is tested in a separate translation unit
+
+void TEST_SM_Executor_count(void* ctx){
+  int* test_context = ctx;
+  (*test_context)++;
+}
+
+UTEST(SM_Executor, step_all){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_do_action(A, TEST_SM_Executor_count);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_compile(sm, 1024);
+
+  enum{ count = 10000 };
+  static int test_context[count];
+  static SM_Context contexts[count];
+  for(int i = 0; i < count; ++i){
+    test_context[i] = 0;
+    SM_Context_init(&contexts[i], &test_context[i]);
+  }
+  contexts[42].halted = true;
+
+  SM_Executor executor;
+  SM_Executor_init(&executor, sm, 4);
+
+  // every context is stepped exactly once per call
+  ASSERT_EQ(SM_Executor_step_all(&executor, contexts, count, sizeof(SM_Context)), (size_t)count - 1);
+  ASSERT_EQ(SM_Executor_step_all(&executor, contexts, count, sizeof(SM_Context)), (size_t)count - 1);
+  ASSERT_EQ(SM_Executor_step_all(&executor, contexts, count, sizeof(SM_Context)), (size_t)count - 1);
+  SM_Executor_destroy(&executor);
+
+  for(int i = 0; i < count; ++i){
+    ASSERT_EQ(test_context[i], i == 42 ? 0 : 2);
+  }
+}
+
+UTEST_MAIN();
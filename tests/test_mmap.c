@@ -0,0 +1,53 @@
+#define SM_IMPLEMENTATION
+#define SM_MMAP
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_MMAP depends on POSIX file mapping so it is tested in a separate translation unit
+
+UTEST(SM_Snapshot, mapped_pool){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_compile(sm, 1024);
+
+  char path[] = "/tmp/sm_test_pool_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_TRUE(fd >= 0);
+  close(fd);
+
+  enum{ count = 100 };
+  SM_ContextPool pool;
+  ASSERT_TRUE(SM_ContextPool_open(&pool, sm, path, NULL, count));
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 0), SM_INITIAL_STATE);
+  SM_ContextPool_step_all(&pool);
+  SM_Context context;
+  SM_ContextPool_load(&pool, 42, &context);
+  ASSERT_TRUE(SM_notify_id(sm, &context, 1, NULL));
+  SM_ContextPool_store(&pool, 42, &context);
+  ASSERT_TRUE(SM_ContextPool_sync(&pool));
+  SM_ContextPool_close(&pool);
+
+  // resumes where it was without loading
+  ASSERT_TRUE(SM_ContextPool_open(&pool, sm, path, NULL, count));
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 41), A);
+  ASSERT_EQ(SM_ContextPool_get_state(&pool, 42), B);
+  SM_ContextPool_close(&pool);
+
+  // other amounts of contexts or state machines are rejected
+  ASSERT_FALSE(SM_ContextPool_open(&pool, sm, path, NULL, count + 1));
+  SM_def(other);
+  SM_State_create(C);
+  SM_Transition_create(other, initial_to_C, SM_INITIAL_STATE, C);
+  SM_compile(other, 1024);
+  ASSERT_FALSE(SM_ContextPool_open(&pool, other, path, NULL, count));
+  unlink(path);
+}
+
+UTEST_MAIN();
@@ -0,0 +1,68 @@
+#define SM_IMPLEMENTATION
+#define SM_PROFILE
+#define SM_PROFILE_TIME() test_time_ns
+#include <stdint.h>
+static uint64_t test_time_ns = 1;
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_PROFILE makes static definitions writable so it is tested in a separate translation unit
+
+// reads back everything written to the file
+size_t TEST_SM_Profile_read(FILE* file, char* buffer, size_t size){
+  rewind(file);
+  size_t length = fread(buffer, 1, size - 1, file);
+  buffer[length] = '\0';
+  return length;
+}
+
+size_t test_profile_guard_calls = 0;
+
+// the last two calls are much slower than the others
+bool TEST_SM_Profile_guard(void* user_context){
+  (void)(user_context);
+  test_time_ns += ++test_profile_guard_calls > 198 ? 1000 : 3;
+  return false;
+}
+
+void TEST_SM_Profile_enter(void* user_context){
+  (void)(user_context);
+}
+
+UTEST(SM_Profile, summary){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_set_enter_action(A, TEST_SM_Profile_enter);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_guard(A_to_final, TEST_SM_Profile_guard);
+
+  SM_compile(sm, 1024);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  for(size_t i = 0; i < 201; ++i) ASSERT_TRUE(SM_step(sm, &context));
+
+  SM_ProfileSummary summary = SM_Profile_summarize(&A_to_final->guard_profile);
+  ASSERT_EQ(summary.count, (uint64_t)200);
+  ASSERT_EQ(summary.min, (uint64_t)3);
+  ASSERT_EQ(summary.p99, (uint64_t)3);
+  ASSERT_NEAR(summary.mean, (198 * 3 + 2 * 1000) / 200.0, 0.001);
+  summary = SM_Profile_summarize(&A_to_final->effect_profile);
+  ASSERT_EQ(summary.count, (uint64_t)0);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  SM_profile_report(sm, file);
+  static char output[1024];
+  TEST_SM_Profile_read(file, output, sizeof(output));
+  fclose(file);
+  ASSERT_STREQ(output,
+      "enter A: count 1, min 0, mean 0.0, p99 1\n"
+      "guard A_to_final: count 200, min 3, mean 13.0, p99 3\n");
+}
+
+UTEST_MAIN();
@@ -0,0 +1,34 @@
+#define SM_IMPLEMENTATION
+#define SM_PROFILE
+#define SM_PROFILE_TIME() SM_TIME_NS()
+#include "sm.h"
+
+#include "utest.h"
+
+// the SM_PROFILE_TIME() fallback off x86 is SM_TIME_NS(), which without SM_STATS has to link against the default clock
+
+bool TEST_SM_Profile_clock_guard(void* user_context){
+  (void)(user_context);
+  return false;
+}
+
+UTEST(SM_Profile, default_clock){
+  SM_def(sm);
+
+  SM_State_create(A);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_final, A, SM_FINAL_STATE);
+  SM_Transition_set_guard(A_to_final, TEST_SM_Profile_clock_guard);
+
+  SM_compile(sm, 1024);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  for(size_t i = 0; i < 11; ++i) ASSERT_TRUE(SM_step(sm, &context));
+
+  SM_ProfileSummary summary = SM_Profile_summarize(&A_to_final->guard_profile);
+  ASSERT_EQ(summary.count, (uint64_t)10);
+}
+
+UTEST_MAIN();
@@ -0,0 +1,118 @@
+#define SM_IMPLEMENTATION
+#define SM_RECORD
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_RECORD logs every call into the state machine so it is tested in a separate translation unit
+
+// reads back everything written to the file
+size_t TEST_SM_Record_read(FILE* file, char* buffer, size_t size){
+  rewind(file);
+  size_t length = fread(buffer, 1, size - 1, file);
+  buffer[length] = '\0';
+  return length;
+}
+
+bool TEST_SM_Record_trigger(void* ctx, void* event){
+  bool* test_event = event;
+  return *test_event;
+}
+
+UTEST(SM_Record, replay){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_State_create(C);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_Transition_create(sm, B_to_C, B, C);
+  SM_Transition_set_trigger(B_to_C, TEST_SM_Record_trigger);
+  SM_Transition_create(sm, C_to_C, C, C);
+  SM_Transition_set_byte_class(C_to_C, "a-z");
+  SM_Transition_create(sm, C_to_final, C, SM_FINAL_STATE);
+  SM_Transition_set_byte_class(C_to_final, ",");
+  SM_compile(sm, 1024);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  char buffer[8]; // flushed many times
+  SM_Recorder recorder;
+  SM_Recorder_init(&recorder, file, buffer, sizeof(buffer), sizeof(bool));
+  SM_Recorder_attach(&recorder);
+
+  SM_Context contexts[3];
+  for(uint32_t i = 0; i < 3; ++i){
+    SM_Context_init(&contexts[i], NULL);
+    SM_Context_set_id(&contexts[i], i);
+    SM_step(sm, &contexts[i]);
+  }
+  bool no = false, yes = true;
+  SM_notify_id(sm, &contexts[0], 1, NULL);
+  SM_notify_id(sm, &contexts[1], 1, NULL);
+  SM_notify(sm, &contexts[0], &no);
+  SM_notify(sm, &contexts[1], &yes);
+  SM_feed_bytes(sm, &contexts[1], "abc,", 4);
+  SM_Recorder_attach(NULL);
+  SM_step(sm, &contexts[2]); // not recorded
+  SM_Recorder_flush(&recorder);
+  ASSERT_TRUE(contexts[1].halted);
+
+  static char log[1024];
+  size_t size = TEST_SM_Record_read(file, log, sizeof(log));
+  fclose(file);
+
+  // only the first two contexts are replayed
+  SM_Context replayed[2];
+  for(uint32_t i = 0; i < 2; ++i) SM_Context_init(&replayed[i], NULL);
+  ASSERT_EQ(SM_replay(sm, replayed, 2, log, size), (size_t)(3 + 5));
+  ASSERT_EQ(replayed[0].current_state, B);
+  ASSERT_TRUE(replayed[1].halted);
+
+  // a truncated log replays every complete record
+  for(uint32_t i = 0; i < 2; ++i) SM_Context_init(&replayed[i], NULL);
+  ASSERT_EQ(SM_replay(sm, replayed, 2, log, size - 1), (size_t)(3 + 4));
+  ASSERT_EQ(replayed[1].current_state, C);
+}
+
+UTEST(SM_Record, regions_not_recorded){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_set_trigger(B_to_A, TEST_SM_Record_trigger);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  char buffer[64];
+  SM_Recorder recorder;
+  SM_Recorder_init(&recorder, file, buffer, sizeof(buffer), sizeof(bool));
+  SM_Recorder_attach(&recorder);
+
+  // regions are stepped through temporary contexts, which can't be replayed
+  SM* regions[1] = {sm};
+  SM_State* current_states[1];
+  SM_RegionContext context;
+  SM_RegionContext_init(&context, regions, current_states, 1, NULL);
+  bool test_event = true;
+  ASSERT_TRUE(SM_RegionContext_step(&context));
+  ASSERT_TRUE(SM_RegionContext_notify_id(&context, 1, NULL));
+  ASSERT_TRUE(SM_RegionContext_notify(&context, &test_event));
+  ASSERT_EQ(current_states[0], A);
+  SM_Recorder_attach(NULL);
+  SM_Recorder_flush(&recorder);
+
+  static char log[1024];
+  size_t size = TEST_SM_Record_read(file, log, sizeof(log));
+  fclose(file);
+  ASSERT_EQ(size, sizeof(SM_RecordHeader));
+}
+
+UTEST_MAIN();
@@ -0,0 +1,74 @@
+#define SM_IMPLEMENTATION
+#define SM_STATS
+#define SM_TIME_NS() test_time_ns
+#include <stdint.h>
+static uint64_t test_time_ns = 1;
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_STATS adds counters to contexts and compiled state machines so it is tested in a separate translation unit
+
+UTEST(SM_Stats, counters){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_create(B);
+  SM_State_set_parent(B, P);
+  SM_State_create(C);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_set_event(A_to_B, 1);
+  SM_Transition_create(sm, B_to_A, B, A);
+  SM_Transition_set_event(B_to_A, 2);
+  SM_Transition_create(sm, P_to_C, P, C);
+  SM_Transition_set_event(P_to_C, 3);
+  SM_Transition_create(sm, C_to_final, C, SM_FINAL_STATE);
+  SM_Transition_set_event(C_to_final, 4);
+
+  SM_compile(sm, 1024);
+  ASSERT_EQ(sm->unique_transition_count, (size_t)6);
+  ASSERT_TRUE(sm->unique_transitions[0] == NULL);
+  ASSERT_EQ(sm->unique_transitions[P_to_C->id], P_to_C);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  test_time_ns = 100;
+  ASSERT_TRUE(SM_step(sm, &context));
+  test_time_ns += 5;
+  ASSERT_TRUE(SM_notify_id(sm, &context, 1, NULL));
+  test_time_ns += 1000;
+  ASSERT_TRUE(SM_notify_id(sm, &context, 2, NULL));
+  test_time_ns += 1 << 20;
+  ASSERT_TRUE(SM_notify_id(sm, &context, 3, NULL));
+  ASSERT_TRUE(SM_notify_id(sm, &context, 4, NULL));
+  ASSERT_TRUE(context.halted);
+
+  SM_StateStats states[5];
+  uint64_t fire_counts[6];
+  ASSERT_EQ(sm->state_count, (size_t)5);
+  SM_stats_snapshot(sm, states, fire_counts);
+  for(size_t id = 1; id < 6; ++id) ASSERT_EQ(fire_counts[id], (uint64_t)1);
+  ASSERT_EQ(states[P->id].enter_count, (uint64_t)1);
+  ASSERT_EQ(states[A->id].enter_count, (uint64_t)2);
+  ASSERT_EQ(states[B->id].enter_count, (uint64_t)1);
+  ASSERT_EQ(states[C->id].enter_count, (uint64_t)1);
+
+  // stays are counted for the innermost state in power of two buckets
+  ASSERT_EQ(states[A->id].dwell[2], (uint64_t)1);
+  ASSERT_EQ(states[A->id].dwell[20], (uint64_t)1);
+  ASSERT_EQ(states[B->id].dwell[9], (uint64_t)1);
+  ASSERT_EQ(states[C->id].dwell[0], (uint64_t)1);
+  ASSERT_EQ(states[P->id].dwell[20], (uint64_t)0);
+
+  SM_stats_clear(sm);
+  SM_stats_snapshot(sm, states, fire_counts);
+  ASSERT_EQ(fire_counts[A_to_B->id], (uint64_t)0);
+  ASSERT_EQ(states[A->id].enter_count, (uint64_t)0);
+  ASSERT_EQ(states[A->id].dwell[2], (uint64_t)0);
+}
+
+UTEST_MAIN();
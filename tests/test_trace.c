@@ -0,0 +1,130 @@
+#define SM_IMPLEMENTATION
+#define SM_TRACE_BINARY
+#define SM_TIME_NS() test_time_ns
+#include <stdint.h>
+static uint64_t test_time_ns = 1;
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_TRACE_BINARY records every transition so it is tested in a separate translation unit
+
+// reads back everything written to the file
+size_t TEST_SM_Trace_read(FILE* file, char* buffer, size_t size){
+  rewind(file);
+  size_t length = fread(buffer, 1, size - 1, file);
+  buffer[length] = '\0';
+  return length;
+}
+
+UTEST(SM_Trace, binary_records){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+  SM_Transition_create(sm, B_to_A, B, A);
+
+  SM_compile(sm, 1024);
+
+  SM_TraceRecord records[4];
+  SM_TraceRing ring;
+  SM_TraceRing_init(&ring, records, 4);
+  SM_TraceRing_attach(&ring);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  SM_Context_set_id(&context, 7);
+  for(size_t i = 0; i < 6; ++i){
+    test_time_ns = 1000 + i;
+    ASSERT_TRUE(SM_step(sm, &context));
+  }
+  SM_TraceRing_attach(NULL);
+  ASSERT_TRUE(SM_step(sm, &context)); // not recorded
+  ASSERT_EQ(ring.dropped, (uint64_t)2);
+
+  SM_TraceRecord read[8];
+  ASSERT_EQ(SM_TraceRing_read(&ring, read, 1), (size_t)1);
+  ASSERT_EQ(read[0].timestamp, (uint64_t)1000);
+  ASSERT_EQ(read[0].context_id, (uint32_t)7);
+  ASSERT_EQ(read[0].transition_id, initial_to_A->id);
+  ASSERT_EQ(SM_TraceRing_read(&ring, read + 1, 8), (size_t)3);
+  ASSERT_EQ(SM_TraceRing_read(&ring, read + 4, 8), (size_t)0);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  SM_trace_decode(sm, read, 4, file);
+  static char output[1024];
+  TEST_SM_Trace_read(file, output, sizeof(output));
+  fclose(file);
+  ASSERT_STREQ(output,
+      "1000 7 initial_to_A: 'SM_INITIAL_STATE' -> 'A'\n"
+      "1001 7 A_to_B: 'A' -> 'B'\n"
+      "1002 7 B_to_A: 'B' -> 'A'\n"
+      "1003 7 A_to_B: 'A' -> 'B'\n");
+}
+
+void TEST_SM_Trace_slow_enter(void* user_context){
+  (void)(user_context);
+  test_time_ns += 250;
+}
+
+UTEST(SM_Trace, chrome_trace){
+  SM_def(sm);
+
+  SM_State_create(P);
+  SM_State_create(A);
+  SM_State_set_parent(A, P);
+  SM_State_create(B);
+  SM_State_set_enter_action(B, TEST_SM_Trace_slow_enter);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, P_to_B, P, B);
+  SM_Transition_create(sm, B_to_final, B, SM_FINAL_STATE);
+
+  SM_compile(sm, 1024);
+
+  SM_TraceRecord records[8];
+  SM_TraceRing ring;
+  SM_TraceRing_init(&ring, records, 8);
+  SM_TraceRing_attach(&ring);
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  SM_Context_set_id(&context, 3);
+  test_time_ns = 1000;
+  while(SM_step(sm, &context)) test_time_ns += 1000;
+  SM_TraceRing_attach(NULL);
+
+  SM_TraceRecord read[8];
+  size_t count = SM_TraceRing_read(&ring, read, 8);
+  ASSERT_EQ(count, (size_t)3);
+  ASSERT_EQ(read[1].duration, (uint32_t)250);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  char buffer[16]; // flushed many times
+  uint16_t states[4];
+  SM_ChromeTrace trace;
+  SM_ChromeTrace_init(&trace, sm, file, buffer, sizeof(buffer), states, 4);
+  SM_ChromeTrace_write(&trace, read, count);
+  SM_ChromeTrace_finish(&trace);
+  static char output[2048];
+  TEST_SM_Trace_read(file, output, sizeof(output));
+  fclose(file);
+  ASSERT_STREQ(output,
+      "{\"traceEvents\":[\n"
+      "{\"name\":\"initial_to_A\",\"cat\":\"transition\",\"ph\":\"X\",\"ts\":1.000,\"dur\":0.000,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"P\",\"cat\":\"state\",\"ph\":\"B\",\"ts\":1.000,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"A\",\"cat\":\"state\",\"ph\":\"B\",\"ts\":1.000,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"A\",\"cat\":\"state\",\"ph\":\"E\",\"ts\":2.000,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"P\",\"cat\":\"state\",\"ph\":\"E\",\"ts\":2.000,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"P_to_B\",\"cat\":\"transition\",\"ph\":\"X\",\"ts\":2.000,\"dur\":0.250,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"B\",\"cat\":\"state\",\"ph\":\"B\",\"ts\":2.250,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"B\",\"cat\":\"state\",\"ph\":\"E\",\"ts\":3.250,\"pid\":1,\"tid\":3},\n"
+      "{\"name\":\"B_to_final\",\"cat\":\"transition\",\"ph\":\"X\",\"ts\":3.250,\"dur\":0.000,\"pid\":1,\"tid\":3}\n"
+      "]}\n");
+}
+
+UTEST_MAIN();
@@ -0,0 +1,39 @@
+#define SM_IMPLEMENTATION
+#define SM_TRACE_BINARY
+#include "sm.h"
+
+#include "utest.h"
+
+// SM_TRACE_BINARY without SM_STATS and without overriding SM_TIME_NS() has to link against the default clock
+
+UTEST(SM_Trace, default_clock){
+  SM_def(sm);
+
+  SM_State_create(A);
+  SM_State_create(B);
+
+  SM_Transition_create(sm, initial_to_A, SM_INITIAL_STATE, A);
+  SM_Transition_create(sm, A_to_B, A, B);
+
+  SM_compile(sm, 1024);
+
+  SM_TraceRecord records[4];
+  SM_TraceRing ring;
+  SM_TraceRing_init(&ring, records, 4);
+  SM_TraceRing_attach(&ring);
+
+  SM_Context context;
+  SM_Context_init(&context, NULL);
+  ASSERT_TRUE(SM_step(sm, &context));
+  ASSERT_TRUE(SM_step(sm, &context));
+  SM_TraceRing_attach(NULL);
+
+  SM_TraceRecord read[4];
+  ASSERT_EQ(SM_TraceRing_read(&ring, read, 4), (size_t)2);
+  ASSERT_EQ(read[0].transition_id, initial_to_A->id);
+  ASSERT_EQ(read[1].transition_id, A_to_B->id);
+  ASSERT_GT(read[0].timestamp, (uint64_t)0);
+  ASSERT_GE(read[1].timestamp, read[0].timestamp);
+}
+
+UTEST_MAIN();